@@ -17,6 +17,16 @@
  */
 
 #include "convert.h"
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
 
 static const char *const error_messages[] = {
     "Success.",                                 // 0
@@ -27,10 +37,28 @@ static const char *const error_messages[] = {
     "\"src_buf\" must be aligned to 32 bytes.", // (-)5
     "\"dst_buf\" must be aligned to 32 bytes.", // (-)6
     "Source buffer must be divisible by 8.",    // (-)7
+    "Curve table must have 4096 entries.",      // (-)8
+    "Curve values must fit into 12 bits.",      // (-)9
+    "Invalid curve parameters.",                // (-)10
+    "Memory allocation failed.",                // (-)11
+    "Invalid operation chain.",                 // (-)12
 };
 
 #define ABS(val) (((val) >= 0) ? (val) : (-(val)))
 
+// every ISA variant is compiled into this object, the SIMD sections are
+// wrapped in target pragmas so the build itself does NOT need -mavx2/-msse4.1
+#define PRAGMA(x) _Pragma(#x)
+#ifdef __clang__
+#define TARGET_PUSH(isa)                                                       \
+  PRAGMA(clang attribute push(__attribute__((target(isa))),                    \
+                              apply_to = function))
+#define TARGET_POP PRAGMA(clang attribute pop)
+#else
+#define TARGET_PUSH(isa) PRAGMA(GCC push_options) PRAGMA(GCC target(isa))
+#define TARGET_POP PRAGMA(GCC pop_options)
+#endif
+
 const char *cl_error_message_from_return_code(int return_code) {
   const unsigned int index = ABS(return_code);
   if (index >= (sizeof(error_messages) / sizeof(char *)))
@@ -40,9 +68,10 @@ const char *cl_error_message_from_return_code(int return_code) {
 
 #define ENCODED_TO_DECODED_SIZE(size) (((size) / 3) << 1)
 
-int u8_buf_12bit_encoded_to_u16_scalar(const uint8_t *src_buf,
-                                       const size_t src_size, uint16_t *dst_buf,
-                                       const size_t dst_size) {
+static inline int u8_buf_12bit_encoded_to_u16_scalar_inline(
+    const uint8_t *src_buf, const size_t src_size, uint16_t *dst_buf,
+    const size_t dst_size, void (*transform_fn)(uint16_t[8], const void *),
+    const void *ctx) {
   if (!src_size)
     return CL_SUCCESS;
   if (src_size % 12)
@@ -67,10 +96,23 @@ int u8_buf_12bit_encoded_to_u16_scalar(const uint8_t *src_buf,
                          (src_buf[i_src + 8] & 0x00FF); // G11G10G9
     dst_buf[i_dst + 7] = ((src_buf[i_src + 10] << 4) & 0x0FF0) |
                          ((src_buf[i_src + 9] >> 4) & 0x000F); // R11R10R9
+    transform_fn(&dst_buf[i_dst], ctx);
   }
   return CL_SUCCESS;
 }
 
+static inline void identity_inline(uint16_t p_buf[8], const void *ctx) {
+  (void)p_buf;
+  (void)ctx;
+}
+
+int u8_buf_12bit_encoded_to_u16_scalar(const uint8_t *src_buf,
+                                       const size_t src_size, uint16_t *dst_buf,
+                                       const size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_scalar_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_inline, NULL);
+}
+
 #ifdef __aarch64__
 // aligned vector load and store operations
 #define vld1q_u8_ex(ptr)                                                       \
@@ -83,6 +125,24 @@ int u8_buf_12bit_encoded_to_u16_scalar(const uint8_t *src_buf,
   vst1q_u8(__builtin_assume_aligned((ptr), sizeof(uint8x16_t)), (val))
 #define vst1q_u16_ex(ptr, val)                                                 \
   vst1q_u16(__builtin_assume_aligned((ptr), sizeof(uint16x8_t)), (val))
+
+// stnp is the non-temporal store, it only takes register pairs so the vector
+// is written as its two d halves (which is still one 16 byte store)
+static inline void vst1q_u8_ex_stream(uint8_t *ptr, const uint8x16_t val,
+                                      const bool stream) {
+  if (stream)
+    __asm__ volatile("stnp %d1, %d2, [%0]"
+                     :
+                     : "r"(ptr), "w"(vget_low_u8(val)), "w"(vget_high_u8(val))
+                     : "memory");
+  else
+    vst1q_u8_ex(ptr, val);
+}
+
+static inline void vst1q_u16_ex_stream(uint16_t *ptr, const uint16x8_t val,
+                                       const bool stream) {
+  vst1q_u8_ex_stream((uint8_t *)ptr, vreinterpretq_u8_u16(val), stream);
+}
 #endif
 
 #ifdef __aarch64__
@@ -109,8 +169,11 @@ _Alignas(int16x8_t) static const int16_t shift_mask_0_4[8] = {0, -4, 0, -4,
       vshlq_u16(vmovl_u8(vget_low_u8(vqtbl1q_u8((__p), (__shuffle_mask_lb)))), \
                 (__shift_mask_0_4)))
 
-int u8_buf_12bit_encoded_to_u16_neon(const uint8_t *src_buf, size_t src_size,
-                                     uint16_t *dst_buf, size_t dst_size) {
+static inline int u8_buf_12bit_encoded_to_u16_neon_inline(
+    const uint8_t *src_buf, size_t src_size, uint16_t *dst_buf,
+    size_t dst_size, uint16x8_t (*transform_fn_neon)(uint16x8_t, const void *),
+    void (*transform_fn_scalar)(uint16_t[8], const void *), const void *ctx,
+    const bool stream) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(uint8x16_t) - 1))
@@ -141,44 +204,92 @@ int u8_buf_12bit_encoded_to_u16_neon(const uint8_t *src_buf, size_t src_size,
   for (size_t i_src = 0, i_dst = 0; i_src < (src_size - (12 * 4 - 1));
        i_src += 12 * 4, i_dst += 8 * 4) {
     const uint8x16_t __v0 = vld1q_u8_ex(&src_buf[i_src]);
-    vst1q_u16_ex(&dst_buf[i_dst],
-                 _12bit_encoded_uint8x16_to_uint16x8(
-                     __v0, __shuffle_mask_hb_u8, __shuffle_mask_lb_u8,
-                     __shift_mask_8_4, __shift_mask_0_4, __and_mask_hb_u8));
+    vst1q_u16_ex_stream(
+        &dst_buf[i_dst],
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                __v0, __shuffle_mask_hb_u8, __shuffle_mask_lb_u8,
+                __shift_mask_8_4, __shift_mask_0_4, __and_mask_hb_u8),
+            ctx),
+        stream);
 
     const uint8x16_t __v1 = vld1q_u8_ex(&src_buf[i_src + 16]);
-    vst1q_u16_ex(&dst_buf[i_dst + 8],
-                 _12bit_encoded_uint8x16_to_uint16x8(
-                     vextq_u8(__v0, __v1, 12), __shuffle_mask_hb_u8,
-                     __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
-                     __and_mask_hb_u8));
+    vst1q_u16_ex_stream(
+        &dst_buf[i_dst + 8],
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                vextq_u8(__v0, __v1, 12), __shuffle_mask_hb_u8,
+                __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
+                __and_mask_hb_u8),
+            ctx),
+        stream);
 
     const uint8x16_t __v2 = vld1q_u8_ex(&src_buf[i_src + 32]);
-    vst1q_u16_ex(&dst_buf[i_dst + 16],
-                 _12bit_encoded_uint8x16_to_uint16x8(
-                     vextq_u8(__v1, __v2, 8), __shuffle_mask_hb_u8,
-                     __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
-                     __and_mask_hb_u8));
-
-    vst1q_u16_ex(&dst_buf[i_dst + 24],
-                 _12bit_encoded_uint8x16_to_uint16x8(
-                     vextq_u8(__v2, __zero_mask, 4), __shuffle_mask_hb_u8,
-                     __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
-                     __and_mask_hb_u8));
+    vst1q_u16_ex_stream(
+        &dst_buf[i_dst + 16],
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                vextq_u8(__v1, __v2, 8), __shuffle_mask_hb_u8,
+                __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
+                __and_mask_hb_u8),
+            ctx),
+        stream);
+
+    vst1q_u16_ex_stream(
+        &dst_buf[i_dst + 24],
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                vextq_u8(__v2, __zero_mask, 4), __shuffle_mask_hb_u8,
+                __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
+                __and_mask_hb_u8),
+            ctx),
+        stream);
   }
 
   if (src_size_cut) {
   done:
-    return u8_buf_12bit_encoded_to_u16_scalar(&src_buf[src_size], src_size_cut,
-                                              &dst_buf[dst_size], dst_size_cut);
+    return u8_buf_12bit_encoded_to_u16_scalar_inline(
+        &src_buf[src_size], src_size_cut, &dst_buf[dst_size], dst_size_cut,
+        transform_fn_scalar, ctx);
   }
 
   return CL_SUCCESS;
 }
 
+static inline uint16x8_t identity_neon_inline(uint16x8_t __p, const void *ctx) {
+  (void)ctx;
+  return __p;
+}
+
+int u8_buf_12bit_encoded_to_u16_neon(const uint8_t *src_buf, size_t src_size,
+                                     uint16_t *dst_buf, size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_neon_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_neon_inline,
+      identity_inline, NULL, false);
+}
+
+int u8_buf_12bit_encoded_to_u16_stream_neon(const uint8_t *src_buf,
+                                            size_t src_size, uint16_t *dst_buf,
+                                            size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_neon_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_neon_inline,
+      identity_inline, NULL, true);
+}
+
 #endif
 
-#ifdef __SSE4_1__
+#ifdef CL_ARCH_X86
+TARGET_PUSH("sse4.1")
+
+// the non-temporal store goes around the caches straight to memory, it only
+// pays off when the buffer would be evicted before it is read again anyway
+static inline void _mm_store_si128_ex(__m128i *__p, const __m128i __v,
+                                      const bool stream) {
+  if (stream)
+    _mm_stream_si128(__p, __v);
+  else
+    _mm_store_si128(__p, __v);
+}
 
 static inline __m128i _mm_12bit_encoded_epu8_to_epu16(
     const __m128i __p, const __m128i __shuffle_mask_hb,
@@ -195,8 +306,11 @@ static inline __m128i _mm_12bit_encoded_epu8_to_epu16(
   return _mm_or_si128(__phb, __plb);
 }
 
-int u8_buf_12bit_encoded_to_u16_sse4(const uint8_t *src_buf, size_t src_size,
-                                     uint16_t *dst_buf, size_t dst_size) {
+static inline int u8_buf_12bit_encoded_to_u16_sse4_inline(
+    const uint8_t *src_buf, size_t src_size, uint16_t *dst_buf,
+    size_t dst_size, __m128i (*transform_fn_sse)(__m128i, const void *),
+    void (*transform_fn_scalar)(uint16_t[8], const void *), const void *ctx,
+    const bool stream) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(__m128i) - 1))
@@ -228,41 +342,91 @@ int u8_buf_12bit_encoded_to_u16_sse4(const uint8_t *src_buf, size_t src_size,
   for (size_t i_src = 0, i_dst = 0; i_src < (src_size - (12 * 4 - 1));
        i_src += 12 * 4, i_dst += 8 * 4) {
     const __m128i __v0 = _mm_load_si128((const __m128i *)&src_buf[i_src]);
-    _mm_store_si128((__m128i *)&dst_buf[i_dst],
-                    _mm_12bit_encoded_epu8_to_epu16(
-                        __v0, __shuffle_mask_hb, __shuffle_mask_lb,
-                        __and_mask_hb, __and_mask_lb));
+    _mm_store_si128_ex(
+        (__m128i *)&dst_buf[i_dst],
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                __v0, __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
+        stream);
 
     const __m128i __v1 = _mm_load_si128((const __m128i *)&src_buf[i_src + 16]);
-    _mm_store_si128((__m128i *)&dst_buf[i_dst + 8],
-                    _mm_12bit_encoded_epu8_to_epu16(
-                        _mm_alignr_epi8(__v1, __v0, 12), __shuffle_mask_hb,
-                        __shuffle_mask_lb, __and_mask_hb, __and_mask_lb));
+    _mm_store_si128_ex(
+        (__m128i *)&dst_buf[i_dst + 8],
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                _mm_alignr_epi8(__v1, __v0, 12), __shuffle_mask_hb,
+                __shuffle_mask_lb, __and_mask_hb, __and_mask_lb),
+            ctx),
+        stream);
 
     const __m128i __v2 = _mm_load_si128((const __m128i *)&src_buf[i_src + 32]);
-    _mm_store_si128((__m128i *)&dst_buf[i_dst + 16],
-                    _mm_12bit_encoded_epu8_to_epu16(
-                        _mm_alignr_epi8(__v2, __v1, 8), __shuffle_mask_hb,
-                        __shuffle_mask_lb, __and_mask_hb, __and_mask_lb));
-
-    _mm_store_si128((__m128i *)&dst_buf[i_dst + 24],
-                    _mm_12bit_encoded_epu8_to_epu16(
-                        _mm_srli_si128(__v2, 4), __shuffle_mask_hb,
-                        __shuffle_mask_lb, __and_mask_hb, __and_mask_lb));
+    _mm_store_si128_ex(
+        (__m128i *)&dst_buf[i_dst + 16],
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                _mm_alignr_epi8(__v2, __v1, 8), __shuffle_mask_hb,
+                __shuffle_mask_lb, __and_mask_hb, __and_mask_lb),
+            ctx),
+        stream);
+
+    _mm_store_si128_ex(
+        (__m128i *)&dst_buf[i_dst + 24],
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                _mm_srli_si128(__v2, 4), __shuffle_mask_hb,
+                __shuffle_mask_lb, __and_mask_hb, __and_mask_lb),
+            ctx),
+        stream);
   }
+  // the streamed stores are weakly ordered, fence them before returning
+  if (stream)
+    _mm_sfence();
 
   if (src_size_cut) {
   done:
-    return u8_buf_12bit_encoded_to_u16_scalar(&src_buf[src_size], src_size_cut,
-                                              &dst_buf[dst_size], dst_size_cut);
+    return u8_buf_12bit_encoded_to_u16_scalar_inline(
+        &src_buf[src_size], src_size_cut, &dst_buf[dst_size], dst_size_cut,
+        transform_fn_scalar, ctx);
   }
 
   return CL_SUCCESS;
 }
 
+static inline __m128i identity_sse4_inline(__m128i __p, const void *ctx) {
+  (void)ctx;
+  return __p;
+}
+
+int u8_buf_12bit_encoded_to_u16_sse4(const uint8_t *src_buf, size_t src_size,
+                                     uint16_t *dst_buf, size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_sse4_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_sse4_inline,
+      identity_inline, NULL, false);
+}
+
+int u8_buf_12bit_encoded_to_u16_stream_sse4(const uint8_t *src_buf,
+                                            size_t src_size, uint16_t *dst_buf,
+                                            size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_sse4_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_sse4_inline,
+      identity_inline, NULL, true);
+}
+
+TARGET_POP
 #endif
 
-#ifdef __AVX2__
+#ifdef CL_ARCH_X86
+TARGET_PUSH("avx2")
+
+static inline void _mm256_store_si256_ex(__m256i *__p, const __m256i __v,
+                                         const bool stream) {
+  if (stream)
+    _mm256_stream_si256(__p, __v);
+  else
+    _mm256_store_si256(__p, __v);
+}
 
 static inline __m256i _mm256_12bit_encoded_epu8_to_epu16(
     const __m256i __p, const __m256i __shuffle_mask_hb,
@@ -284,8 +448,11 @@ static inline __m256i _mm256_12bit_encoded_epu8_to_epu16(
   return _mm256_or_si256(__phb, __plb);
 }
 
-int u8_buf_12bit_encoded_to_u16_avx2(const uint8_t *src_buf, size_t src_size,
-                                     uint16_t *dst_buf, size_t dst_size) {
+static inline int u8_buf_12bit_encoded_to_u16_avx2_inline(
+    const uint8_t *src_buf, size_t src_size, uint16_t *dst_buf,
+    size_t dst_size, __m256i (*transform_fn_avx)(__m256i, const void *),
+    void (*transform_fn_scalar)(uint16_t[8], const void *), const void *ctx,
+    const bool stream) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(__m256i) - 1))
@@ -325,60 +492,96 @@ int u8_buf_12bit_encoded_to_u16_avx2(const uint8_t *src_buf, size_t src_size,
     const __m128i __v00 = _mm256_castsi256_si128(__v0);
     const __m128i __v01 = _mm256_extracti128_si256(__v0, 1);
 
-    _mm256_store_si256(
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst],
-        _mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(_mm256_castsi128_si256(__v00),
-                                    _mm_alignr_epi8(__v01, __v00, 12), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb));
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(_mm256_castsi128_si256(__v00),
+                                        _mm_alignr_epi8(__v01, __v00, 12), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
+        stream);
 
     const __m256i __v1 =
         _mm256_load_si256((const __m256i *)&src_buf[i_src + 32]);
     const __m128i __v10 = _mm256_castsi256_si128(__v1);
     const __m128i __v11 = _mm256_extracti128_si256(__v1, 1);
 
-    _mm256_store_si256(
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst + 16],
-        _mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(
-                _mm256_castsi128_si256(_mm_alignr_epi8(__v10, __v01, 8)),
-                _mm_srli_si128(__v10, 4), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb));
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(
+                    _mm256_castsi128_si256(_mm_alignr_epi8(__v10, __v01, 8)),
+                    _mm_srli_si128(__v10, 4), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
+        stream);
 
     const __m256i __v2 =
         _mm256_load_si256((const __m256i *)&src_buf[i_src + 64]);
     const __m128i __v20 = _mm256_castsi256_si128(__v2);
     const __m128i __v21 = _mm256_extracti128_si256(__v2, 1);
 
-    _mm256_store_si256(
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst + 32],
-        _mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(_mm256_castsi128_si256(__v11),
-                                    _mm_alignr_epi8(__v20, __v11, 12), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb));
-
-    _mm256_store_si256(
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(_mm256_castsi128_si256(__v11),
+                                        _mm_alignr_epi8(__v20, __v11, 12), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
+        stream);
+
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst + 48],
-        _mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(
-                _mm256_castsi128_si256(_mm_alignr_epi8(__v21, __v20, 8)),
-                _mm_srli_si128(__v21, 4), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb));
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(
+                    _mm256_castsi128_si256(_mm_alignr_epi8(__v21, __v20, 8)),
+                    _mm_srli_si128(__v21, 4), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
+        stream);
   }
+  if (stream)
+    _mm_sfence();
 
   if (src_size_cut) {
   done:
-    return u8_buf_12bit_encoded_to_u16_scalar(&src_buf[src_size], src_size_cut,
-                                              &dst_buf[dst_size], dst_size_cut);
+    return u8_buf_12bit_encoded_to_u16_scalar_inline(
+        &src_buf[src_size], src_size_cut, &dst_buf[dst_size], dst_size_cut,
+        transform_fn_scalar, ctx);
   }
 
   return CL_SUCCESS;
 }
 
+static inline __m256i identity_avx2_inline(__m256i __p, const void *ctx) {
+  (void)ctx;
+  return __p;
+}
+
+int u8_buf_12bit_encoded_to_u16_avx2(const uint8_t *src_buf, size_t src_size,
+                                     uint16_t *dst_buf, size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_avx2_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_avx2_inline,
+      identity_inline, NULL, false);
+}
+
+int u8_buf_12bit_encoded_to_u16_stream_avx2(const uint8_t *src_buf,
+                                            size_t src_size, uint16_t *dst_buf,
+                                            size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_avx2_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_avx2_inline,
+      identity_inline, NULL, true);
+}
+
+TARGET_POP
 #endif
 
 #define DECODED_TO_ENCODED_SIZE(size) (((size) >> 1) * 3)
@@ -434,8 +637,9 @@ _Alignas(uint8x16_t) static const uint8_t and_mask_hb_u16[16] = {
       vqtbl1q_u8(vreinterpretq_u8_u16(vshlq_u16((__v), (__shift_mask_8_4))),   \
                  (__dst_shuffle_mask_lb)))
 
-int u16_buf_to_u8_12bit_encoded_neon(const uint16_t *src_buf, size_t src_size,
-                                     uint8_t *dst_buf, size_t dst_size) {
+static inline int u16_buf_to_u8_12bit_encoded_neon_inline(
+    const uint16_t *src_buf, size_t src_size, uint8_t *dst_buf,
+    size_t dst_size, const bool stream) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(uint16x8_t) - 1))
@@ -474,25 +678,28 @@ int u16_buf_to_u8_12bit_encoded_neon(const uint16_t *src_buf, size_t src_size,
         vld1q_u16_ex(&src_buf[i_src + 8]), __and_mask_hb_u16, __shiftr_mask_8_4,
         __shiftl_mask_0_4, __shuffle_mask_hb_u16, __shuffle_mask_lb_u16);
 
-    vst1q_u8_ex(&dst_buf[i_dst],
-                vorrq_u8(__v0, vextq_u8(__zero_mask, __v1, 4)));
+    vst1q_u8_ex_stream(&dst_buf[i_dst],
+                       vorrq_u8(__v0, vextq_u8(__zero_mask, __v1, 4)), stream);
 
     const uint8x16_t __v2 = _uint16x8_to_12bit_encoded_uint8x16(
         vld1q_u16_ex(&src_buf[i_src + 16]), __and_mask_hb_u16,
         __shiftr_mask_8_4, __shiftl_mask_0_4, __shuffle_mask_hb_u16,
         __shuffle_mask_lb_u16);
 
-    vst1q_u8_ex(&dst_buf[i_dst + 16], vorrq_u8(vextq_u8(__v1, __zero_mask, 4),
-                                               vextq_u8(__zero_mask, __v2, 8)));
+    vst1q_u8_ex_stream(&dst_buf[i_dst + 16],
+                       vorrq_u8(vextq_u8(__v1, __zero_mask, 4),
+                                vextq_u8(__zero_mask, __v2, 8)),
+                       stream);
 
     const uint8x16_t __v3 = _uint16x8_to_12bit_encoded_uint8x16(
         vld1q_u16_ex(&src_buf[i_src + 24]), __and_mask_hb_u16,
         __shiftr_mask_8_4, __shiftl_mask_0_4, __shuffle_mask_hb_u16,
         __shuffle_mask_lb_u16);
 
-    vst1q_u8_ex(&dst_buf[i_dst + 32],
-                vorrq_u8(vextq_u8(__v2, __zero_mask, 8),
-                         vextq_u8(__zero_mask, __v3, 12)));
+    vst1q_u8_ex_stream(&dst_buf[i_dst + 32],
+                       vorrq_u8(vextq_u8(__v2, __zero_mask, 8),
+                                vextq_u8(__zero_mask, __v3, 12)),
+                       stream);
   }
 
   if (src_size_cut) {
@@ -504,9 +711,23 @@ int u16_buf_to_u8_12bit_encoded_neon(const uint16_t *src_buf, size_t src_size,
   return CL_SUCCESS;
 }
 
+int u16_buf_to_u8_12bit_encoded_neon(const uint16_t *src_buf, size_t src_size,
+                                     uint8_t *dst_buf, size_t dst_size) {
+  return u16_buf_to_u8_12bit_encoded_neon_inline(src_buf, src_size, dst_buf,
+                                                 dst_size, false);
+}
+
+int u16_buf_to_u8_12bit_encoded_stream_neon(const uint16_t *src_buf,
+                                            size_t src_size, uint8_t *dst_buf,
+                                            size_t dst_size) {
+  return u16_buf_to_u8_12bit_encoded_neon_inline(src_buf, src_size, dst_buf,
+                                                 dst_size, true);
+}
+
 #endif
 
-#ifdef __SSE4_1__
+#ifdef CL_ARCH_X86
+TARGET_PUSH("sse4.1")
 
 static inline __m128i _mm_epu16_to_12bit_encoded_epu8(
     const __m128i __v, const __m128i __and_mask_hb, const __m128i __and_mask_lb,
@@ -524,8 +745,9 @@ static inline __m128i _mm_epu16_to_12bit_encoded_epu8(
           __dst_shuffle_mask_lb));
 }
 
-int u16_buf_to_u8_12bit_encoded_sse4(const uint16_t *src_buf, size_t src_size,
-                                     uint8_t *dst_buf, size_t dst_size) {
+static inline int u16_buf_to_u8_12bit_encoded_sse4_inline(
+    const uint16_t *src_buf, size_t src_size, uint8_t *dst_buf,
+    size_t dst_size, const bool stream) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(__m128i) - 1))
@@ -565,25 +787,29 @@ int u16_buf_to_u8_12bit_encoded_sse4(const uint16_t *src_buf, size_t src_size,
         _mm_load_si128((const __m128i *)&src_buf[i_src + 8]), __and_mask_hb,
         __and_mask_lb, __dst_shuffle_mask_hb, __dst_shuffle_mask_lb);
 
-    _mm_store_si128((__m128i *)&dst_buf[i_dst],
-                    _mm_or_si128(__v0, _mm_slli_si128(__v1, 12)));
+    _mm_store_si128_ex((__m128i *)&dst_buf[i_dst],
+                       _mm_or_si128(__v0, _mm_slli_si128(__v1, 12)), stream);
 
     const __m128i __v2 = _mm_epu16_to_12bit_encoded_epu8(
         _mm_load_si128((const __m128i *)&src_buf[i_src + 16]), __and_mask_hb,
         __and_mask_lb, __dst_shuffle_mask_hb, __dst_shuffle_mask_lb);
 
-    _mm_store_si128(
+    _mm_store_si128_ex(
         (__m128i *)&dst_buf[i_dst + 16],
-        _mm_or_si128(_mm_srli_si128(__v1, 4), _mm_slli_si128(__v2, 8)));
+        _mm_or_si128(_mm_srli_si128(__v1, 4), _mm_slli_si128(__v2, 8)),
+        stream);
 
     const __m128i __v3 = _mm_epu16_to_12bit_encoded_epu8(
         _mm_load_si128((const __m128i *)&src_buf[i_src + 24]), __and_mask_hb,
         __and_mask_lb, __dst_shuffle_mask_hb, __dst_shuffle_mask_lb);
 
-    _mm_store_si128(
+    _mm_store_si128_ex(
         (__m128i *)&dst_buf[i_dst + 32],
-        _mm_or_si128(_mm_srli_si128(__v2, 8), _mm_slli_si128(__v3, 4)));
+        _mm_or_si128(_mm_srli_si128(__v2, 8), _mm_slli_si128(__v3, 4)),
+        stream);
   }
+  if (stream)
+    _mm_sfence();
 
   if (src_size_cut) {
   done:
@@ -594,9 +820,24 @@ int u16_buf_to_u8_12bit_encoded_sse4(const uint16_t *src_buf, size_t src_size,
   return CL_SUCCESS;
 }
 
+int u16_buf_to_u8_12bit_encoded_sse4(const uint16_t *src_buf, size_t src_size,
+                                     uint8_t *dst_buf, size_t dst_size) {
+  return u16_buf_to_u8_12bit_encoded_sse4_inline(src_buf, src_size, dst_buf,
+                                                 dst_size, false);
+}
+
+int u16_buf_to_u8_12bit_encoded_stream_sse4(const uint16_t *src_buf,
+                                            size_t src_size, uint8_t *dst_buf,
+                                            size_t dst_size) {
+  return u16_buf_to_u8_12bit_encoded_sse4_inline(src_buf, src_size, dst_buf,
+                                                 dst_size, true);
+}
+
+TARGET_POP
 #endif
 
-#ifdef __AVX2__
+#ifdef CL_ARCH_X86
+TARGET_PUSH("avx2")
 
 static inline __m256i _mm256_epu16_to_12bit_encoded_epu8(
     const __m256i __v, const __m256i __and_mask_hb, const __m256i __and_mask_lb,
@@ -620,8 +861,9 @@ static inline __m256i _mm256_epu16_to_12bit_encoded_epu8(
       _mm_srli_si128(__res_h, 4), 1);
 }
 
-int u16_buf_to_u8_12bit_encoded_avx2(const uint16_t *src_buf, size_t src_size,
-                                     uint8_t *dst_buf, size_t dst_size) {
+static inline int u16_buf_to_u8_12bit_encoded_avx2_inline(
+    const uint16_t *src_buf, size_t src_size, uint8_t *dst_buf,
+    size_t dst_size, const bool stream) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(__m256i) - 1))
@@ -663,29 +905,31 @@ int u16_buf_to_u8_12bit_encoded_avx2(const uint16_t *src_buf, size_t src_size,
     const __m256i __v1 = _mm256_epu16_to_12bit_encoded_epu8(
         _mm256_load_si256((const __m256i *)&src_buf[i_src + 16]), __and_mask_hb,
         __and_mask_lb, __dst_shuffle_mask_hb, __dst_shuffle_mask_lb);
-    _mm256_store_si256(
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst],
         _mm256_or_si256(
             __v0, _mm256_inserti128_si256(
                       _mm256_setzero_si256(),
-                      _mm_slli_si128(_mm256_castsi256_si128(__v1), 8), 1)));
+                      _mm_slli_si128(_mm256_castsi256_si128(__v1), 8), 1)),
+        stream);
 
     const __m256i __v2 = _mm256_epu16_to_12bit_encoded_epu8(
         _mm256_load_si256((const __m256i *)&src_buf[i_src + 32]), __and_mask_hb,
         __and_mask_lb, __dst_shuffle_mask_hb, __dst_shuffle_mask_lb);
 
-    _mm256_store_si256(
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst + 32],
         _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_alignr_epi8(
                                     _mm256_extracti128_si256(__v1, 1),
                                     _mm256_castsi256_si128(__v1), 8)),
-                                _mm256_castsi256_si128(__v2), 1));
+                                _mm256_castsi256_si128(__v2), 1),
+        stream);
 
     const __m256i __v3 = _mm256_epu16_to_12bit_encoded_epu8(
         _mm256_load_si256((const __m256i *)&src_buf[i_src + 48]), __and_mask_hb,
         __and_mask_lb, __dst_shuffle_mask_hb, __dst_shuffle_mask_lb);
 
-    _mm256_store_si256(
+    _mm256_store_si256_ex(
         (__m256i *)&dst_buf[i_dst + 64],
         _mm256_inserti128_si256(
             _mm256_castsi128_si256(
@@ -693,8 +937,11 @@ int u16_buf_to_u8_12bit_encoded_avx2(const uint16_t *src_buf, size_t src_size,
                              _mm_slli_si128(_mm256_castsi256_si128(__v3), 8))),
             _mm_or_si128(_mm_srli_si128(_mm256_castsi256_si128(__v3), 8),
                          _mm_slli_si128(_mm256_extracti128_si256(__v3, 1), 8)),
-            1));
+            1),
+        stream);
   }
+  if (stream)
+    _mm_sfence();
 
   if (src_size_cut) {
   done:
@@ -705,16 +952,106 @@ int u16_buf_to_u8_12bit_encoded_avx2(const uint16_t *src_buf, size_t src_size,
   return CL_SUCCESS;
 }
 
+int u16_buf_to_u8_12bit_encoded_avx2(const uint16_t *src_buf, size_t src_size,
+                                     uint8_t *dst_buf, size_t dst_size) {
+  return u16_buf_to_u8_12bit_encoded_avx2_inline(src_buf, src_size, dst_buf,
+                                                 dst_size, false);
+}
+
+int u16_buf_to_u8_12bit_encoded_stream_avx2(const uint16_t *src_buf,
+                                            size_t src_size, uint8_t *dst_buf,
+                                            size_t dst_size) {
+  return u16_buf_to_u8_12bit_encoded_avx2_inline(src_buf, src_size, dst_buf,
+                                                 dst_size, true);
+}
+
+TARGET_POP
 #endif
 
+// reflected Castagnoli polynomial (iSCSI, ext4, SSE4.2 and ARMv8 crc32c)
+#define CRC32C_POLY 0x82F63B78
+
+static uint32_t crc32c_table[256];
+
+static void crc32c_table_init(void) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    crc32c_table[i] = crc;
+  }
+}
+
+// works on the inverted CRC, like the crc32 instructions
+static inline uint32_t crc32c_scalar_inline(uint32_t crc, const uint8_t *buf,
+                                            const size_t size) {
+  for (size_t i = 0; i < size; ++i)
+    crc = crc32c_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+  return crc;
+}
+
+uint32_t cl_crc32c_scalar(const uint32_t crc, const void *buf,
+                          const size_t size) {
+  return ~crc32c_scalar_inline(~crc, (const uint8_t *)buf, size);
+}
+
+// the checksum of a range is (x^(8 * n) mod P) * crc, the powers x^(2^k) are
+// squared once, so combining costs O(log n) instead of O(n)
+static uint32_t crc32c_x2n_table[32];
+
+// a * b mod P, bit 31 is x^0 in the reflected representation
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b) {
+  uint32_t m = (uint32_t)1 << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0)
+        break;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+  }
+  return p;
+}
+
+static void crc32c_x2n_table_init(void) {
+  uint32_t p = (uint32_t)1 << 30; // x^1
+  crc32c_x2n_table[0] = p;
+  for (int n = 1; n < 32; ++n)
+    crc32c_x2n_table[n] = p = crc32c_multmodp(p, p);
+}
+
+// x^(n * 2^k) mod P
+static uint32_t crc32c_x2nmodp(size_t n, unsigned int k) {
+  uint32_t p = (uint32_t)1 << 31; // x^0
+  while (n) {
+    if (n & 1)
+      p = crc32c_multmodp(crc32c_x2n_table[k & 31], p);
+    n >>= 1;
+    ++k;
+  }
+  return p;
+}
+
+uint32_t cl_crc32c_combine(const uint32_t crc1, const uint32_t crc2,
+                           const size_t size2) {
+  return crc32c_multmodp(crc32c_x2nmodp(size2, 3), crc1) ^ crc2;
+}
+
+// if crc is NOT NULL the CRC32C of the output is updated block by block,
+// while the block is still in the registers (or L1), instead of reading the
+// whole buffer a second time
 static inline int u8_buf_12bit_encoded_transform_inplace_scalar_inline(
     uint8_t *src_buf, const size_t src_size,
-    void (*transform_fn)(uint16_t[8])) {
+    void (*transform_fn)(uint16_t[8], const void *), const void *ctx,
+    uint32_t *crc) {
   if (!src_size)
     return CL_SUCCESS;
   if (src_size % 12)
     return CL_ERR_SBUF_DIV_12;
 
+  uint32_t crc_state = (crc != NULL) ? ~*crc : 0;
   uint16_t dst_temp[8];
   for (size_t i_src = 0; i_src < (src_size - 11); i_src += 12) {
     dst_temp[0] = ((src_buf[i_src + 2] << 8) & 0x0F00) |
@@ -734,7 +1071,7 @@ static inline int u8_buf_12bit_encoded_transform_inplace_scalar_inline(
     dst_temp[7] = ((src_buf[i_src + 10] << 4) & 0x0FF0) |
                   ((src_buf[i_src + 9] >> 4) & 0x000F); // R11R10R9
 
-    transform_fn(dst_temp);
+    transform_fn(dst_temp, ctx);
 
     src_buf[i_src] = (dst_temp[3] >> 4) & 0xFF; // R5R4
     src_buf[i_src + 1] = dst_temp[0] & 0xFF;    // G1G0
@@ -752,16 +1089,39 @@ static inline int u8_buf_12bit_encoded_transform_inplace_scalar_inline(
         ((dst_temp[7] << 4) & 0xF0) | ((dst_temp[6] >> 8) & 0x0F); // R9G11
     src_buf[i_src + 10] = (dst_temp[7] >> 4) & 0xFF;               // R11R10
     src_buf[i_src + 11] = dst_temp[4] & 0xFF;                      // G7G6
+
+    if (crc != NULL)
+      crc_state = crc32c_scalar_inline(crc_state, &src_buf[i_src], 12);
   }
 
+  if (crc != NULL)
+    *crc = ~crc_state;
   return CL_SUCCESS;
 }
 
+// the internal engines hand a context to the transform functions,
+// the public ones take plain function pointers, these adapt between the two
+typedef struct transform_fns {
+  void (*scalar)(uint16_t[8]);
+#ifdef __aarch64__
+  uint16x8_t (*neon)(uint16x8_t);
+#endif
+#ifdef CL_ARCH_X86
+  __m128i (*sse)(__m128i);
+  __m256i (*avx)(__m256i);
+#endif
+} transform_fns_t;
+
+static void call_transform_fn_scalar(uint16_t p_buf[8], const void *ctx) {
+  ((const transform_fns_t *)ctx)->scalar(p_buf);
+}
+
 int u8_buf_12bit_encoded_transform_inplace_scalar(
     uint8_t *src_buf, const size_t src_size,
     void (*transform_fn)(uint16_t[8])) {
-  return u8_buf_12bit_encoded_transform_inplace_scalar_inline(src_buf, src_size,
-                                                              transform_fn);
+  const transform_fns_t fns = {.scalar = transform_fn};
+  return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+      src_buf, src_size, call_transform_fn_scalar, &fns, NULL);
 }
 
 #define LOG2U16(x)                                                             \
@@ -783,7 +1143,9 @@ static inline uint16_t linear_16bit_to_log_encoded_12bit(uint16_t v) {
 
 #define _12BIT_TO_16BIT(v) ((v) << 4)
 
-static inline void to_log_encoded_12bit_inline(uint16_t p_buf[8]) {
+static inline void to_log_encoded_12bit_inline(uint16_t p_buf[8],
+                                               const void *ctx) {
+  (void)ctx;
   p_buf[0] = linear_16bit_to_log_encoded_12bit(_12BIT_TO_16BIT(p_buf[0]));
   p_buf[1] = linear_16bit_to_log_encoded_12bit(_12BIT_TO_16BIT(p_buf[1]));
   p_buf[2] = linear_16bit_to_log_encoded_12bit(_12BIT_TO_16BIT(p_buf[2]));
@@ -797,15 +1159,389 @@ static inline void to_log_encoded_12bit_inline(uint16_t p_buf[8]) {
 int u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(uint8_t *src_buf,
                                                      const size_t src_size) {
   return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
-      src_buf, src_size, to_log_encoded_12bit_inline);
+      src_buf, src_size, to_log_encoded_12bit_inline, NULL, NULL);
+}
+
+#define LUT_SIZE_12BIT (1 << 12)
+#define MAX_12BIT (LUT_SIZE_12BIT - 1)
+
+// the unpacked pixels are only 12 bit wide, so every curve fits into a
+// 8 KiB table (L1), the 2 entries of padding are read by the 32 bit AVX2 gather
+struct cl_curve {
+  _Alignas(32) uint16_t lut[LUT_SIZE_12BIT + 2];
+};
+
+// inverse of linear_16bit_to_log_encoded_12bit, which keeps the top
+// 10 bits of the linear value, so log -> linear -> log is lossless
+static inline uint16_t log_encoded_12bit_to_linear_16bit(uint16_t v) {
+  const uint16_t q = (v >> 9) - 1;
+  return (v < 1024) ? v : (((v & 0x01FF) | 0x0200) << q);
+}
+
+#define _16BIT_TO_12BIT(v) ((v) >> 4)
+
+static cl_curve_t log_encoded_12bit_curve;
+static cl_curve_t log_decoded_12bit_curve;
+static cl_curve_t log_decoded_16bit_curve;
+
+static void log_encoded_12bit_curves_init(void) {
+  for (uint16_t v = 0; v < LUT_SIZE_12BIT; ++v) {
+    log_encoded_12bit_curve.lut[v] =
+        linear_16bit_to_log_encoded_12bit(_12BIT_TO_16BIT(v));
+    log_decoded_16bit_curve.lut[v] = log_encoded_12bit_to_linear_16bit(v);
+    log_decoded_12bit_curve.lut[v] =
+        _16BIT_TO_12BIT(log_decoded_16bit_curve.lut[v]);
+  }
+}
+
+static cl_curve_t *cl_curve_alloc(void) {
+  return (cl_curve_t *)aligned_alloc(_Alignof(cl_curve_t), sizeof(cl_curve_t));
+}
+
+int cl_curve_from_table(cl_curve_t **curve, const uint16_t *table,
+                        const size_t table_size) {
+  if (table_size != LUT_SIZE_12BIT)
+    return CL_ERR_CURVE_SIZE;
+  for (size_t i = 0; i < table_size; ++i) {
+    if (table[i] > MAX_12BIT)
+      return CL_ERR_CURVE_RANGE;
+  }
+  cl_curve_t *c = cl_curve_alloc();
+  if (c == NULL)
+    return CL_ERR_ALLOC;
+  memcpy(c->lut, table, sizeof(uint16_t) * LUT_SIZE_12BIT);
+  c->lut[LUT_SIZE_12BIT] = c->lut[LUT_SIZE_12BIT + 1] = 0;
+  *curve = c;
+  return CL_SUCCESS;
+}
+
+// convert.c is built with -Ofast, which folds isfinite to true, so the
+// exponent bits are checked directly (all set for NaN and infinity)
+static bool is_finite(const double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  return ((bits >> 52) & 0x7FF) != 0x7FF;
+}
+
+int cl_curve_from_params(cl_curve_t **curve, const cl_curve_params_t *params) {
+  const double knee = params->knee;
+  const double knee_out = knee * params->slope;
+  // NaN fails every comparison below, so it would reach the uint16_t cast
+  if (!is_finite(params->slope) || !is_finite(params->gamma))
+    return CL_ERR_CURVE_PARAMS;
+  if (params->knee >= MAX_12BIT || params->slope < 0.0 || knee_out > MAX_12BIT)
+    return CL_ERR_CURVE_PARAMS;
+  switch (params->type) {
+  case CL_CURVE_LOG:
+    if (params->knee == 0)
+      return CL_ERR_CURVE_PARAMS;
+    break;
+  case CL_CURVE_GAMMA:
+    if (!(params->gamma > 0.0))
+      return CL_ERR_CURVE_PARAMS;
+    break;
+  default:
+    return CL_ERR_CURVE_PARAMS;
+  }
+  cl_curve_t *c = cl_curve_alloc();
+  if (c == NULL)
+    return CL_ERR_ALLOC;
+
+  // linear below the knee, above it [knee, 4095] maps onto [knee_out, 4095]
+  for (size_t v = 0; v < LUT_SIZE_12BIT; ++v) {
+    double out;
+    if (v < params->knee) {
+      out = v * params->slope;
+    } else if (params->type == CL_CURVE_LOG) {
+      out = knee_out + (MAX_12BIT - knee_out) * log2(v / knee) /
+                           log2(MAX_12BIT / knee);
+    } else {
+      out = knee_out + (MAX_12BIT - knee_out) *
+                           pow((v - knee) / (MAX_12BIT - knee),
+                               1.0 / params->gamma);
+    }
+    out = round(out);
+    c->lut[v] = (out > MAX_12BIT) ? MAX_12BIT : (uint16_t)out;
+  }
+  c->lut[LUT_SIZE_12BIT] = c->lut[LUT_SIZE_12BIT + 1] = 0;
+  *curve = c;
+  return CL_SUCCESS;
+}
+
+void cl_curve_free(cl_curve_t *curve) { free(curve); }
+
+const uint16_t *cl_curve_table(const cl_curve_t *curve) { return curve->lut; }
+
+static inline void apply_curve_inline(uint16_t p_buf[8], const void *ctx) {
+  const uint16_t *lut = ((const cl_curve_t *)ctx)->lut;
+  p_buf[0] = lut[p_buf[0]];
+  p_buf[1] = lut[p_buf[1]];
+  p_buf[2] = lut[p_buf[2]];
+  p_buf[3] = lut[p_buf[3]];
+  p_buf[4] = lut[p_buf[4]];
+  p_buf[5] = lut[p_buf[5]];
+  p_buf[6] = lut[p_buf[6]];
+  p_buf[7] = lut[p_buf[7]];
+}
+
+int u8_buf_12bit_encoded_apply_curve_scalar(uint8_t *src_buf,
+                                            const size_t src_size,
+                                            const cl_curve_t *curve) {
+  return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+      src_buf, src_size, apply_curve_inline, curve, NULL);
+}
+
+int u8_buf_12bit_encoded_to_log_encoded_12bit_lut_scalar(
+    uint8_t *src_buf, const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_scalar(src_buf, src_size,
+                                                 &log_encoded_12bit_curve);
+}
+
+int u8_buf_log_encoded_12bit_to_u16_scalar(const uint8_t *src_buf,
+                                           const size_t src_size,
+                                           uint16_t *dst_buf,
+                                           const size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_scalar_inline(
+      src_buf, src_size, dst_buf, dst_size, apply_curve_inline,
+      &log_decoded_16bit_curve);
+}
+
+int u8_buf_log_encoded_12bit_to_linear_12bit_scalar(uint8_t *src_buf,
+                                                    const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_scalar(src_buf, src_size,
+                                                 &log_decoded_12bit_curve);
+}
+
+// gains are stored as 4.12 fixed point, so (v << 4) * gain >> 16 equals
+// v * gain >> 12 and maps onto a single mulhi on every ISA
+#define GAIN_FRAC_BITS 12
+#define GAIN_MAX ((double)UINT16_MAX / (1 << GAIN_FRAC_BITS))
+
+// the per channel arguments are expanded to one vector of lanes
+// (G, R, G, R, ...) the SIMD ops load directly, the curve ops keep a pointer
+struct cl_op_chain_op {
+  _Alignas(32) uint16_t arg[16];
+  const cl_curve_t *curve;
+  int type;
+};
+
+struct cl_op_chain {
+  size_t n_ops;
+  struct cl_op_chain_op ops[CL_OP_CHAIN_MAX];
+};
+
+int cl_op_chain_create(cl_op_chain_t **chain, const cl_op_t *ops,
+                       const size_t n_ops) {
+  if (n_ops > CL_OP_CHAIN_MAX)
+    return CL_ERR_OP_CHAIN;
+  cl_op_chain_t *c = (cl_op_chain_t *)aligned_alloc(_Alignof(cl_op_chain_t),
+                                                    sizeof(cl_op_chain_t));
+  if (c == NULL)
+    return CL_ERR_ALLOC;
+  c->n_ops = n_ops;
+  for (size_t i = 0; i < n_ops; ++i) {
+    struct cl_op_chain_op *op = &c->ops[i];
+    op->type = ops[i].type;
+    op->curve = NULL;
+    // the vector loops load arg for every op, also the ones NOT using it
+    memset(op->arg, 0, sizeof(op->arg));
+    for (size_t lane = 0; lane < 16; ++lane) {
+      const size_t ch = lane & 1;
+      switch (ops[i].type) {
+      case CL_OP_BLACK_LEVEL:
+      case CL_OP_CLAMP:
+        if (ops[i].value[ch] > MAX_12BIT)
+          goto error;
+        op->arg[lane] = ops[i].value[ch];
+        break;
+      case CL_OP_GAIN:
+        if (!(ops[i].gain[ch] >= 0.0 && ops[i].gain[ch] < GAIN_MAX))
+          goto error;
+        op->arg[lane] =
+            (uint16_t)lround(ops[i].gain[ch] * (1 << GAIN_FRAC_BITS));
+        break;
+      case CL_OP_CURVE:
+        if (ops[i].curve == NULL)
+          goto error;
+        op->curve = ops[i].curve;
+        break;
+      case CL_OP_LOG_ENCODE:
+        op->curve = &log_encoded_12bit_curve;
+        break;
+      default:
+        goto error;
+      }
+    }
+  }
+  *chain = c;
+  return CL_SUCCESS;
+error:
+  free(c);
+  return CL_ERR_OP_CHAIN;
+}
+
+void cl_op_chain_free(cl_op_chain_t *chain) { free(chain); }
+
+static inline void apply_op_chain_inline(uint16_t p_buf[8], const void *ctx) {
+  const cl_op_chain_t *chain = (const cl_op_chain_t *)ctx;
+  for (size_t i = 0; i < chain->n_ops; ++i) {
+    const struct cl_op_chain_op *op = &chain->ops[i];
+    switch (op->type) {
+    case CL_OP_BLACK_LEVEL:
+      for (size_t lane = 0; lane < 8; ++lane)
+        p_buf[lane] =
+            (p_buf[lane] > op->arg[lane]) ? p_buf[lane] - op->arg[lane] : 0;
+      break;
+    case CL_OP_GAIN:
+      for (size_t lane = 0; lane < 8; ++lane) {
+        const uint32_t v = ((uint32_t)p_buf[lane] * op->arg[lane]) >>
+                           GAIN_FRAC_BITS;
+        p_buf[lane] = (v > MAX_12BIT) ? MAX_12BIT : v;
+      }
+      break;
+    case CL_OP_CLAMP:
+      for (size_t lane = 0; lane < 8; ++lane)
+        p_buf[lane] = (p_buf[lane] > op->arg[lane]) ? op->arg[lane]
+                                                    : p_buf[lane];
+      break;
+    default: // CL_OP_CURVE, CL_OP_LOG_ENCODE
+      apply_curve_inline(p_buf, op->curve);
+      break;
+    }
+  }
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_scalar(uint8_t *src_buf,
+                                               const size_t src_size,
+                                               const cl_op_chain_t *chain) {
+  return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+      src_buf, src_size, apply_op_chain_inline, chain, NULL);
+}
+
+static cl_op_chain_t log_encoded_12bit_op_chain = {
+    .n_ops = 1,
+    .ops = {{.curve = &log_encoded_12bit_curve, .type = CL_OP_LOG_ENCODE}}};
+
+// incrementing the same bin back to back stalls on the store of the previous
+// increment, so the lanes are spread over 4 sub-histograms (lane & 3), which
+// keeps the channels apart as well: even sub-histograms are G, odd are R
+#define STATS_SUB_HISTS 4
+
+struct cl_stats {
+  uint64_t sub_hist[STATS_SUB_HISTS][LUT_SIZE_12BIT];
+};
+
+int cl_stats_create(cl_stats_t **stats) {
+  cl_stats_t *s = (cl_stats_t *)aligned_alloc(64, sizeof(cl_stats_t));
+  if (s == NULL)
+    return CL_ERR_ALLOC;
+  cl_stats_reset(s);
+  *stats = s;
+  return CL_SUCCESS;
+}
+
+void cl_stats_free(cl_stats_t *stats) { free(stats); }
+
+void cl_stats_reset(cl_stats_t *stats) {
+  memset(stats->sub_hist, 0, sizeof(stats->sub_hist));
+}
+
+void cl_stats_merge(cl_stats_t *dst, const cl_stats_t *src) {
+  for (size_t i = 0; i < STATS_SUB_HISTS; ++i) {
+    for (size_t v = 0; v < LUT_SIZE_12BIT; ++v)
+      dst->sub_hist[i][v] += src->sub_hist[i][v];
+  }
+}
+
+void cl_stats_channel(const cl_stats_t *stats, const int channel,
+                      cl_channel_stats_t *channel_stats) {
+  uint64_t sum = 0;
+  channel_stats->count = 0;
+  channel_stats->min = channel_stats->max = 0;
+  for (size_t v = 0; v < LUT_SIZE_12BIT; ++v) {
+    uint64_t n = 0;
+    for (size_t i = (channel & 1); i < STATS_SUB_HISTS; i += 2)
+      n += stats->sub_hist[i][v];
+    channel_stats->hist[v] = n;
+    if (!n)
+      continue;
+    if (!channel_stats->count)
+      channel_stats->min = v;
+    channel_stats->max = v;
+    channel_stats->count += n;
+    sum += n * v;
+  }
+  channel_stats->mean =
+      channel_stats->count ? (double)sum / channel_stats->count : 0.0;
+}
+
+static inline void stats_add_inline(cl_stats_t *stats,
+                                    const uint16_t p_buf[8]) {
+  for (size_t lane = 0; lane < 8; ++lane)
+    ++stats->sub_hist[lane & (STATS_SUB_HISTS - 1)][p_buf[lane]];
+}
+
+// the sinks only see the output of the transform, every transform the sinks
+// are combined with keeps the pixels in 12 bit
+struct stats_ctx {
+  const void *ctx;
+  cl_stats_t *stats;
+};
+
+static inline void identity_stats_inline(uint16_t p_buf[8], const void *ctx) {
+  stats_add_inline(((const struct stats_ctx *)ctx)->stats, p_buf);
+}
+
+static inline void apply_op_chain_stats_inline(uint16_t p_buf[8],
+                                               const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  apply_op_chain_inline(p_buf, sctx->ctx);
+  stats_add_inline(sctx->stats, p_buf);
+}
+
+int u8_buf_12bit_encoded_to_u16_stats_scalar(const uint8_t *src_buf,
+                                             const size_t src_size,
+                                             uint16_t *dst_buf,
+                                             const size_t dst_size,
+                                             cl_stats_t *stats) {
+  const struct stats_ctx sctx = {NULL, stats};
+  return u8_buf_12bit_encoded_to_u16_scalar_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_stats_inline, &sctx);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_stats_scalar(
+    uint8_t *src_buf, const size_t src_size, const cl_op_chain_t *chain,
+    cl_stats_t *stats) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+      src_buf, src_size, apply_op_chain_stats_inline, &sctx, NULL);
+}
+
+// the sink is optional, every block takes the same branch. a single copy of
+// the engine stays small enough to be inlined with the checksum
+static inline void apply_op_chain_opt_stats_inline(uint16_t p_buf[8],
+                                                   const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  apply_op_chain_inline(p_buf, sctx->ctx);
+  if (sctx->stats != NULL)
+    stats_add_inline(sctx->stats, p_buf);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_scalar(
+    uint8_t *src_buf, const size_t src_size, const cl_op_chain_t *chain,
+    cl_stats_t *stats, uint32_t *crc) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+      src_buf, src_size, apply_op_chain_opt_stats_inline, &sctx, crc);
 }
 
 #ifdef __aarch64__
 
 static inline int u8_buf_12bit_encoded_transform_inplace_neon_inline(
     uint8_t *src_buf, size_t src_size,
-    uint16x8_t (*transform_fn_neon)(uint16x8_t),
-    void (*transform_fn_scalar)(uint16_t[8])) {
+    uint16x8_t (*transform_fn_neon)(uint16x8_t, const void *),
+    void (*transform_fn_scalar)(uint16_t[8], const void *), const void *ctx,
+    uint32_t (*crc_fn_neon)(uint32_t, uint8x16_t), uint32_t *crc) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(uint8x16_t) - 1))
@@ -833,77 +1569,105 @@ static inline int u8_buf_12bit_encoded_transform_inplace_neon_inline(
   const int16x8_t __shiftr_mask_8_4 = vnegq_s16(__shift_mask_8_4);
   const int16x8_t __shiftl_mask_0_4 = vnegq_s16(__shift_mask_0_4);
 
+  uint32_t crc_state = (crc != NULL) ? ~*crc : 0;
   for (size_t i_src = 0; i_src < (src_size - (12 * 4 - 1)); i_src += 12 * 4) {
 
     const uint8x16_t __v0 = vld1q_u8_ex(&src_buf[i_src]);
 
     const uint8x16_t __v0_res = _uint16x8_to_12bit_encoded_uint8x16(
-        transform_fn_neon(_12bit_encoded_uint8x16_to_uint16x8(
-            __v0, __shuffle_mask_hb_u8, __shuffle_mask_lb_u8, __shift_mask_8_4,
-            __shift_mask_0_4, __and_mask_hb_u8)),
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                __v0, __shuffle_mask_hb_u8, __shuffle_mask_lb_u8,
+                __shift_mask_8_4, __shift_mask_0_4, __and_mask_hb_u8),
+            ctx),
         __and_mask_hb_u16, __shiftr_mask_8_4, __shiftl_mask_0_4,
         __shuffle_mask_hb_u16, __shuffle_mask_lb_u16);
 
     const uint8x16_t __v1 = vld1q_u8_ex(&src_buf[i_src + 16]);
 
     const uint8x16_t __v1_res = _uint16x8_to_12bit_encoded_uint8x16(
-        transform_fn_neon(_12bit_encoded_uint8x16_to_uint16x8(
-            vextq_u8(__v0, __v1, 12), __shuffle_mask_hb_u8,
-            __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
-            __and_mask_hb_u8)),
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                vextq_u8(__v0, __v1, 12), __shuffle_mask_hb_u8,
+                __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
+                __and_mask_hb_u8),
+            ctx),
         __and_mask_hb_u16, __shiftr_mask_8_4, __shiftl_mask_0_4,
         __shuffle_mask_hb_u16, __shuffle_mask_lb_u16);
 
-    vst1q_u8_ex(&src_buf[i_src],
-                vorrq_u8(__v0_res, vextq_u8(__zero_mask, __v1_res, 4)));
+    const uint8x16_t __o0 =
+        vorrq_u8(__v0_res, vextq_u8(__zero_mask, __v1_res, 4));
+    vst1q_u8_ex(&src_buf[i_src], __o0);
+    if (crc != NULL)
+      crc_state = crc_fn_neon(crc_state, __o0);
 
     const uint8x16_t __v2 = vld1q_u8_ex(&src_buf[i_src + 32]);
 
     const uint8x16_t __v2_res = _uint16x8_to_12bit_encoded_uint8x16(
-        transform_fn_neon(_12bit_encoded_uint8x16_to_uint16x8(
-            vextq_u8(__v1, __v2, 8), __shuffle_mask_hb_u8, __shuffle_mask_lb_u8,
-            __shift_mask_8_4, __shift_mask_0_4, __and_mask_hb_u8)),
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                vextq_u8(__v1, __v2, 8), __shuffle_mask_hb_u8,
+                __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
+                __and_mask_hb_u8),
+            ctx),
         __and_mask_hb_u16, __shiftr_mask_8_4, __shiftl_mask_0_4,
         __shuffle_mask_hb_u16, __shuffle_mask_lb_u16);
 
-    vst1q_u8_ex(&src_buf[i_src + 16],
-                vorrq_u8(vextq_u8(__v1_res, __zero_mask, 4),
-                         vextq_u8(__zero_mask, __v2_res, 8)));
+    const uint8x16_t __o1 = vorrq_u8(vextq_u8(__v1_res, __zero_mask, 4),
+                                     vextq_u8(__zero_mask, __v2_res, 8));
+    vst1q_u8_ex(&src_buf[i_src + 16], __o1);
+    if (crc != NULL)
+      crc_state = crc_fn_neon(crc_state, __o1);
 
     const uint8x16_t __v3_res = _uint16x8_to_12bit_encoded_uint8x16(
-        transform_fn_neon(_12bit_encoded_uint8x16_to_uint16x8(
-            vextq_u8(__v2, __zero_mask, 4), __shuffle_mask_hb_u8,
-            __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
-            __and_mask_hb_u8)),
+        transform_fn_neon(
+            _12bit_encoded_uint8x16_to_uint16x8(
+                vextq_u8(__v2, __zero_mask, 4), __shuffle_mask_hb_u8,
+                __shuffle_mask_lb_u8, __shift_mask_8_4, __shift_mask_0_4,
+                __and_mask_hb_u8),
+            ctx),
         __and_mask_hb_u16, __shiftr_mask_8_4, __shiftl_mask_0_4,
         __shuffle_mask_hb_u16, __shuffle_mask_lb_u16);
 
-    vst1q_u8_ex(&src_buf[i_src + 32],
-                vorrq_u8(vextq_u8(__v2_res, __zero_mask, 8),
-                         vextq_u8(__zero_mask, __v3_res, 12)));
+    const uint8x16_t __o2 = vorrq_u8(vextq_u8(__v2_res, __zero_mask, 8),
+                                     vextq_u8(__zero_mask, __v3_res, 12));
+    vst1q_u8_ex(&src_buf[i_src + 32], __o2);
+    if (crc != NULL)
+      crc_state = crc_fn_neon(crc_state, __o2);
   }
+  if (crc != NULL)
+    *crc = ~crc_state;
 
   if (src_size_cut) {
   done:
-    return u8_buf_12bit_encoded_transform_inplace_scalar(
-        &src_buf[src_size], src_size_cut, transform_fn_scalar);
+    return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+        &src_buf[src_size], src_size_cut, transform_fn_scalar, ctx, crc);
   }
 
   return CL_SUCCESS;
 }
 
+static uint16x8_t call_transform_fn_neon(uint16x8_t __p, const void *ctx) {
+  return ((const transform_fns_t *)ctx)->neon(__p);
+}
+
 int u8_buf_12bit_encoded_transform_inplace_neon(
     uint8_t *src_buf, const size_t src_size,
     uint16x8_t (*transform_fn_neon)(uint16x8_t),
     void (*transform_fn_scalar)(uint16_t[8])) {
+  const transform_fns_t fns = {.neon = transform_fn_neon,
+                               .scalar = transform_fn_scalar};
   return u8_buf_12bit_encoded_transform_inplace_neon_inline(
-      src_buf, src_size, transform_fn_neon, transform_fn_scalar);
+      src_buf, src_size, call_transform_fn_neon, call_transform_fn_scalar,
+      &fns, NULL, NULL);
 }
 
 #define vbsrq_u16(a)                                                           \
   vsubq_u16(vdupq_n_u16(8 * sizeof(uint16_t) - 1), vclzq_u16((a)))
 
-static inline uint16x8_t to_log_encoded_12bit_neon_inline(uint16x8_t __p) {
+static inline uint16x8_t to_log_encoded_12bit_neon_inline(uint16x8_t __p,
+                                                          const void *ctx) {
+  (void)ctx;
   __p = vshlq_n_u16(__p, 4);
   const uint16x8_t __q = vsubq_u16(vbsrq_u16(__p), vdupq_n_u16(9));
   return vbslq_u16(
@@ -917,16 +1681,180 @@ int u8_buf_12bit_encoded_to_log_encoded_12bit_neon(uint8_t *src_buf,
                                                    const size_t src_size) {
   return u8_buf_12bit_encoded_transform_inplace_neon_inline(
       src_buf, src_size, to_log_encoded_12bit_neon_inline,
-      to_log_encoded_12bit_inline);
+      to_log_encoded_12bit_inline, NULL, NULL, NULL);
 }
 
+// NEON has NO gather either, tbl only covers 64 bytes
+static inline uint16x8_t apply_curve_neon_inline(uint16x8_t __p,
+                                                 const void *ctx) {
+  _Alignas(uint16x8_t) uint16_t p_buf[8];
+  vst1q_u16_ex(p_buf, __p);
+  apply_curve_inline(p_buf, ctx);
+  return vld1q_u16_ex(p_buf);
+}
+
+int u8_buf_12bit_encoded_apply_curve_neon(uint8_t *src_buf,
+                                          const size_t src_size,
+                                          const cl_curve_t *curve) {
+  return u8_buf_12bit_encoded_transform_inplace_neon_inline(
+      src_buf, src_size, apply_curve_neon_inline, apply_curve_inline, curve,
+      NULL, NULL);
+}
+
+int u8_buf_log_encoded_12bit_to_u16_neon(const uint8_t *src_buf,
+                                         const size_t src_size,
+                                         uint16_t *dst_buf,
+                                         const size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_neon_inline(
+      src_buf, src_size, dst_buf, dst_size, apply_curve_neon_inline,
+      apply_curve_inline, &log_decoded_16bit_curve, false);
+}
+
+int u8_buf_log_encoded_12bit_to_linear_12bit_neon(uint8_t *src_buf,
+                                                  const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_neon(src_buf, src_size,
+                                               &log_decoded_12bit_curve);
+}
+
+static inline uint16x8_t apply_op_chain_neon_inline(uint16x8_t __p,
+                                                    const void *ctx) {
+  const cl_op_chain_t *chain = (const cl_op_chain_t *)ctx;
+  for (size_t i = 0; i < chain->n_ops; ++i) {
+    const struct cl_op_chain_op *op = &chain->ops[i];
+    const uint16x8_t __arg = vld1q_u16_ex(op->arg);
+    switch (op->type) {
+    case CL_OP_BLACK_LEVEL:
+      __p = vqsubq_u16(__p, __arg);
+      break;
+    case CL_OP_GAIN:
+      __p = vminq_u16(
+          vcombine_u16(
+              vshrn_n_u32(vmull_u16(vget_low_u16(__p), vget_low_u16(__arg)),
+                          GAIN_FRAC_BITS),
+              vshrn_n_u32(vmull_high_u16(__p, __arg), GAIN_FRAC_BITS)),
+          vdupq_n_u16(MAX_12BIT));
+      break;
+    case CL_OP_CLAMP:
+      __p = vminq_u16(__p, __arg);
+      break;
+    default: // CL_OP_CURVE, CL_OP_LOG_ENCODE
+      __p = apply_curve_neon_inline(__p, op->curve);
+      break;
+    }
+  }
+  return __p;
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_neon(uint8_t *src_buf,
+                                             const size_t src_size,
+                                             const cl_op_chain_t *chain) {
+  return u8_buf_12bit_encoded_transform_inplace_neon_inline(
+      src_buf, src_size, apply_op_chain_neon_inline, apply_op_chain_inline,
+      chain, NULL, NULL);
+}
+
+static inline uint16x8_t stats_add_neon_inline(cl_stats_t *stats,
+                                               uint16x8_t __p) {
+  _Alignas(uint16x8_t) uint16_t p_buf[8];
+  vst1q_u16_ex(p_buf, __p);
+  stats_add_inline(stats, p_buf);
+  return __p;
+}
+
+static inline uint16x8_t apply_op_chain_stats_neon_inline(uint16x8_t __p,
+                                                          const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  return stats_add_neon_inline(sctx->stats,
+                               apply_op_chain_neon_inline(__p, sctx->ctx));
+}
+
+static inline uint16x8_t identity_stats_neon_inline(uint16x8_t __p,
+                                                    const void *ctx) {
+  return stats_add_neon_inline(((const struct stats_ctx *)ctx)->stats, __p);
+}
+
+static inline uint16x8_t apply_op_chain_opt_stats_neon_inline(uint16x8_t __p,
+                                                              const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  __p = apply_op_chain_neon_inline(__p, sctx->ctx);
+  return (sctx->stats != NULL) ? stats_add_neon_inline(sctx->stats, __p) : __p;
+}
+
+int u8_buf_12bit_encoded_to_u16_stats_neon(const uint8_t *src_buf,
+                                           const size_t src_size,
+                                           uint16_t *dst_buf,
+                                           const size_t dst_size,
+                                           cl_stats_t *stats) {
+  const struct stats_ctx sctx = {NULL, stats};
+  return u8_buf_12bit_encoded_to_u16_neon_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_stats_neon_inline,
+      identity_stats_inline, &sctx, false);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_stats_neon(uint8_t *src_buf,
+                                                   const size_t src_size,
+                                                   const cl_op_chain_t *chain,
+                                                   cl_stats_t *stats) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_neon_inline(
+      src_buf, src_size, apply_op_chain_stats_neon_inline,
+      apply_op_chain_stats_inline, &sctx, NULL, NULL);
+}
+
+// the CRC instructions are optional before ARMv8.1, without them (e.g. a
+// generic -march=armv8-a build) the lanes go through the table
+static inline uint32_t crc32c_u64_neon(uint32_t crc, const uint64_t v) {
+#ifdef __ARM_FEATURE_CRC32
+  return __crc32cd(crc, v);
+#else
+  uint8_t buf[8];
+  memcpy(buf, &v, sizeof(buf));
+  return crc32c_scalar_inline(crc, buf, sizeof(buf));
 #endif
+}
 
-#ifdef __SSE4_1__
+static inline uint32_t crc32c_neon_inline(uint32_t crc, uint8x16_t __v) {
+  const uint64x2_t __v64 = vreinterpretq_u64_u8(__v);
+  crc = crc32c_u64_neon(crc, vgetq_lane_u64(__v64, 0));
+  return crc32c_u64_neon(crc, vgetq_lane_u64(__v64, 1));
+}
 
-static inline int u8_buf_12bit_encoded_transform_inplace_sse4_inline(
-    uint8_t *src_buf, size_t src_size, __m128i (*transform_fn_sse)(__m128i),
-    void (*transform_fn_scalar)(uint16_t[8])) {
+uint32_t cl_crc32c_neon(const uint32_t crc, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  uint32_t crc_state = ~crc;
+  for (; size >= sizeof(uint64_t);
+       p += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    crc_state = crc32c_u64_neon(crc_state, v);
+  }
+  return ~crc32c_scalar_inline(crc_state, p, size);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_neon(uint8_t *src_buf,
+                                                    const size_t src_size,
+                                                    const cl_op_chain_t *chain,
+                                                    cl_stats_t *stats,
+                                                    uint32_t *crc) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_neon_inline(
+      src_buf, src_size, apply_op_chain_opt_stats_neon_inline,
+      apply_op_chain_opt_stats_inline, &sctx, crc32c_neon_inline, crc);
+}
+
+#endif
+
+#ifdef CL_ARCH_X86
+TARGET_PUSH("sse4.1")
+
+// always inlined, a clone of the engine would be compiled for SSE4.1 and
+// could NOT inline the checksum (SSE4.2) of the _crc32c variant
+static inline __attribute__((always_inline)) int
+u8_buf_12bit_encoded_transform_inplace_sse4_inline(
+    uint8_t *src_buf, size_t src_size,
+    __m128i (*transform_fn_sse)(__m128i, const void *),
+    void (*transform_fn_scalar)(uint16_t[8], const void *), const void *ctx,
+    uint32_t (*crc_fn_sse)(uint32_t, __m128i), uint32_t *crc) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(__m128i) - 1))
@@ -956,68 +1884,92 @@ static inline int u8_buf_12bit_encoded_transform_inplace_sse4_inline(
   const __m128i __dst_shuffle_mask_lb =
       _mm_setr_epi8(6, -1, 0, 2, 8, 10, -1, 4, -1, 12, 14, -1, -1, -1, -1, -1);
 
+  uint32_t crc_state = (crc != NULL) ? ~*crc : 0;
   for (size_t i_src = 0; i_src < (src_size - (12 * 4 - 1)); i_src += 12 * 4) {
     const __m128i __v0 = _mm_load_si128((const __m128i *)&src_buf[i_src]);
 
     const __m128i __v0_res = _mm_epu16_to_12bit_encoded_epu8(
-        transform_fn_sse(_mm_12bit_encoded_epu8_to_epu16(
-            __v0, __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb)),
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                __v0, __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
     const __m128i __v1 = _mm_load_si128((const __m128i *)&src_buf[i_src + 16]);
 
     const __m128i __v1_res = _mm_epu16_to_12bit_encoded_epu8(
-        transform_fn_sse(_mm_12bit_encoded_epu8_to_epu16(
-            _mm_alignr_epi8(__v1, __v0, 12), __shuffle_mask_hb,
-            __shuffle_mask_lb, __and_mask_hb, __and_mask_lb)),
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                _mm_alignr_epi8(__v1, __v0, 12), __shuffle_mask_hb,
+                __shuffle_mask_lb, __and_mask_hb, __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
-    _mm_store_si128((__m128i *)&src_buf[i_src],
-                    _mm_or_si128(__v0_res, _mm_slli_si128(__v1_res, 12)));
+    const __m128i __o0 = _mm_or_si128(__v0_res, _mm_slli_si128(__v1_res, 12));
+    _mm_store_si128((__m128i *)&src_buf[i_src], __o0);
+    if (crc != NULL)
+      crc_state = crc_fn_sse(crc_state, __o0);
 
     const __m128i __v2 = _mm_load_si128((const __m128i *)&src_buf[i_src + 32]);
 
     const __m128i __v2_res = _mm_epu16_to_12bit_encoded_epu8(
-        transform_fn_sse(_mm_12bit_encoded_epu8_to_epu16(
-            _mm_alignr_epi8(__v2, __v1, 8), __shuffle_mask_hb,
-            __shuffle_mask_lb, __and_mask_hb, __and_mask_lb)),
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                _mm_alignr_epi8(__v2, __v1, 8), __shuffle_mask_hb,
+                __shuffle_mask_lb, __and_mask_hb, __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
-    _mm_store_si128(
-        (__m128i *)&src_buf[i_src + 16],
-        _mm_or_si128(_mm_srli_si128(__v1_res, 4), _mm_slli_si128(__v2_res, 8)));
+    const __m128i __o1 =
+        _mm_or_si128(_mm_srli_si128(__v1_res, 4), _mm_slli_si128(__v2_res, 8));
+    _mm_store_si128((__m128i *)&src_buf[i_src + 16], __o1);
+    if (crc != NULL)
+      crc_state = crc_fn_sse(crc_state, __o1);
 
     const __m128i __v3_res = _mm_epu16_to_12bit_encoded_epu8(
-        transform_fn_sse(_mm_12bit_encoded_epu8_to_epu16(
-            _mm_srli_si128(__v2, 4), __shuffle_mask_hb, __shuffle_mask_lb,
-            __and_mask_hb, __and_mask_lb)),
+        transform_fn_sse(
+            _mm_12bit_encoded_epu8_to_epu16(
+                _mm_srli_si128(__v2, 4), __shuffle_mask_hb, __shuffle_mask_lb,
+                __and_mask_hb, __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
-    _mm_store_si128(
-        (__m128i *)&src_buf[i_src + 32],
-        _mm_or_si128(_mm_srli_si128(__v2_res, 8), _mm_slli_si128(__v3_res, 4)));
+    const __m128i __o2 =
+        _mm_or_si128(_mm_srli_si128(__v2_res, 8), _mm_slli_si128(__v3_res, 4));
+    _mm_store_si128((__m128i *)&src_buf[i_src + 32], __o2);
+    if (crc != NULL)
+      crc_state = crc_fn_sse(crc_state, __o2);
   }
+  if (crc != NULL)
+    *crc = ~crc_state;
 
   if (src_size_cut) {
   done:
-    return u8_buf_12bit_encoded_transform_inplace_scalar(
-        &src_buf[src_size], src_size_cut, transform_fn_scalar);
+    return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+        &src_buf[src_size], src_size_cut, transform_fn_scalar, ctx, crc);
   }
 
   return CL_SUCCESS;
 }
 
+static __m128i call_transform_fn_sse4(__m128i __p, const void *ctx) {
+  return ((const transform_fns_t *)ctx)->sse(__p);
+}
+
 int u8_buf_12bit_encoded_transform_inplace_sse4(
     uint8_t *src_buf, const size_t src_size,
     __m128i (*transform_fn_sse)(__m128i),
     void (*transform_fn_scalar)(uint16_t[8])) {
+  const transform_fns_t fns = {.sse = transform_fn_sse,
+                               .scalar = transform_fn_scalar};
   return u8_buf_12bit_encoded_transform_inplace_sse4_inline(
-      src_buf, src_size, transform_fn_sse, transform_fn_scalar);
+      src_buf, src_size, call_transform_fn_sse4, call_transform_fn_scalar,
+      &fns, NULL, NULL);
 }
 
 /**
@@ -1040,18 +1992,8 @@ static inline __m128i _mm_bsr_epi16(__m128i __h) {
   return _mm_max_epi8(_mm_sub_epi8(__h, __adj), _mm_srli_epi16(__h, 8));
 }
 
-#if defined(__AVX2__)
-
-static inline __m128i _mm_srlv_epi16x(__m128i __a, __m128i __count) {
-  return _mm_packus_epi32(
-      _mm_srlv_epi32(_mm_cvtepu16_epi32(__a), _mm_cvtepu16_epi32(__count)),
-      _mm_srlv_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(__a, 8)),
-                     _mm_cvtepu16_epi32(_mm_srli_si128(__count, 8))));
-}
-
-#else
-
 // sse4.1 does NOT support _mm_srlv_epi32
+// (the sse4 kernels only get dispatched to on CPUs without AVX2)
 // in my tests the fastest way to do a vector shift
 // is going back to scalars :/
 
@@ -1078,13 +2020,13 @@ static inline __m128i _mm_srlv_epi16x(__m128i __a, __m128i __count) {
   return _mm_load_si128(&a.__values);
 }
 
-#endif
-
 #define _mm_cmplt_epu16(a, b)                                                  \
   _mm_cmplt_epi16(_mm_xor_si128(a, _mm_set1_epi16(0x8000)),                    \
                   _mm_xor_si128(b, _mm_set1_epi16(0x8000)))
 
-static inline __m128i to_log_encoded_12bit_sse4_inline(__m128i __p) {
+static inline __m128i to_log_encoded_12bit_sse4_inline(__m128i __p,
+                                                       const void *ctx) {
+  (void)ctx;
   __p = _mm_slli_epi16(__p, 4);
   const __m128i __q = _mm_sub_epi16(_mm_bsr_epi16(__p), _mm_set1_epi16(9));
   return _mm_blendv_epi8(
@@ -1096,16 +2038,190 @@ int u8_buf_12bit_encoded_to_log_encoded_12bit_sse4(uint8_t *src_buf,
                                                    const size_t src_size) {
   return u8_buf_12bit_encoded_transform_inplace_sse4_inline(
       src_buf, src_size, to_log_encoded_12bit_sse4_inline,
-      to_log_encoded_12bit_inline);
+      to_log_encoded_12bit_inline, NULL, NULL, NULL);
+}
+
+// sse4.1 has NO gather, but 8 table loads are still cheaper than
+// the scalar variable shift of to_log_encoded_12bit_sse4_inline
+static inline __m128i apply_curve_sse4_inline(__m128i __p, const void *ctx) {
+  const uint16_t *lut = ((const cl_curve_t *)ctx)->lut;
+  return _mm_setr_epi16(
+      lut[_mm_extract_epi16(__p, 0)], lut[_mm_extract_epi16(__p, 1)],
+      lut[_mm_extract_epi16(__p, 2)], lut[_mm_extract_epi16(__p, 3)],
+      lut[_mm_extract_epi16(__p, 4)], lut[_mm_extract_epi16(__p, 5)],
+      lut[_mm_extract_epi16(__p, 6)], lut[_mm_extract_epi16(__p, 7)]);
+}
+
+int u8_buf_12bit_encoded_apply_curve_sse4(uint8_t *src_buf,
+                                          const size_t src_size,
+                                          const cl_curve_t *curve) {
+  return u8_buf_12bit_encoded_transform_inplace_sse4_inline(
+      src_buf, src_size, apply_curve_sse4_inline, apply_curve_inline, curve,
+      NULL, NULL);
+}
+
+int u8_buf_log_encoded_12bit_to_u16_sse4(const uint8_t *src_buf,
+                                         const size_t src_size,
+                                         uint16_t *dst_buf,
+                                         const size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_sse4_inline(
+      src_buf, src_size, dst_buf, dst_size, apply_curve_sse4_inline,
+      apply_curve_inline, &log_decoded_16bit_curve, false);
+}
+
+int u8_buf_log_encoded_12bit_to_linear_12bit_sse4(uint8_t *src_buf,
+                                                  const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_sse4(src_buf, src_size,
+                                               &log_decoded_12bit_curve);
+}
+
+static inline __m128i apply_op_chain_sse4_inline(__m128i __p, const void *ctx) {
+  const cl_op_chain_t *chain = (const cl_op_chain_t *)ctx;
+  for (size_t i = 0; i < chain->n_ops; ++i) {
+    const struct cl_op_chain_op *op = &chain->ops[i];
+    const __m128i __arg = _mm_load_si128((const __m128i *)op->arg);
+    switch (op->type) {
+    case CL_OP_BLACK_LEVEL:
+      __p = _mm_subs_epu16(__p, __arg);
+      break;
+    case CL_OP_GAIN:
+      __p = _mm_min_epu16(
+          _mm_mulhi_epu16(_mm_slli_epi16(__p, 16 - GAIN_FRAC_BITS), __arg),
+          _mm_set1_epi16(MAX_12BIT));
+      break;
+    case CL_OP_CLAMP:
+      __p = _mm_min_epu16(__p, __arg);
+      break;
+    default: // CL_OP_CURVE, CL_OP_LOG_ENCODE
+      __p = apply_curve_sse4_inline(__p, op->curve);
+      break;
+    }
+  }
+  return __p;
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_sse4(uint8_t *src_buf,
+                                             const size_t src_size,
+                                             const cl_op_chain_t *chain) {
+  return u8_buf_12bit_encoded_transform_inplace_sse4_inline(
+      src_buf, src_size, apply_op_chain_sse4_inline, apply_op_chain_inline,
+      chain, NULL, NULL);
+}
+
+static inline __m128i stats_add_sse4_inline(cl_stats_t *stats, __m128i __p) {
+  _Alignas(__m128i) uint16_t p_buf[8];
+  _mm_store_si128((__m128i *)p_buf, __p);
+  stats_add_inline(stats, p_buf);
+  return __p;
+}
+
+static inline __m128i apply_op_chain_stats_sse4_inline(__m128i __p,
+                                                       const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  return stats_add_sse4_inline(sctx->stats,
+                               apply_op_chain_sse4_inline(__p, sctx->ctx));
 }
 
+static inline __m128i identity_stats_sse4_inline(__m128i __p, const void *ctx) {
+  return stats_add_sse4_inline(((const struct stats_ctx *)ctx)->stats, __p);
+}
+
+static inline __m128i apply_op_chain_opt_stats_sse4_inline(__m128i __p,
+                                                           const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  __p = apply_op_chain_sse4_inline(__p, sctx->ctx);
+  return (sctx->stats != NULL) ? stats_add_sse4_inline(sctx->stats, __p) : __p;
+}
+
+int u8_buf_12bit_encoded_to_u16_stats_sse4(const uint8_t *src_buf,
+                                           const size_t src_size,
+                                           uint16_t *dst_buf,
+                                           const size_t dst_size,
+                                           cl_stats_t *stats) {
+  const struct stats_ctx sctx = {NULL, stats};
+  return u8_buf_12bit_encoded_to_u16_sse4_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_stats_sse4_inline,
+      identity_stats_inline, &sctx, false);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_stats_sse4(uint8_t *src_buf,
+                                                   const size_t src_size,
+                                                   const cl_op_chain_t *chain,
+                                                   cl_stats_t *stats) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_sse4_inline(
+      src_buf, src_size, apply_op_chain_stats_sse4_inline,
+      apply_op_chain_stats_inline, &sctx, NULL, NULL);
+}
+
+int u8_buf_12bit_encoded_to_log_encoded_12bit_lut_sse4(uint8_t *src_buf,
+                                                       const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_sse4(src_buf, src_size,
+                                               &log_encoded_12bit_curve);
+}
+
+TARGET_POP
+#endif
+
+// the crc32 instruction came with SSE4.2, one step later than the kernels
+#ifdef CL_ARCH_X86
+TARGET_PUSH("sse4.2")
+
+static inline uint32_t crc32c_u64_sse4(const uint32_t crc, const uint64_t v) {
+#ifdef __x86_64__
+  return (uint32_t)_mm_crc32_u64(crc, v);
+#else
+  return _mm_crc32_u32(_mm_crc32_u32(crc, (uint32_t)v), (uint32_t)(v >> 32));
+#endif
+}
+
+static inline uint32_t crc32c_sse4_inline(const uint32_t crc, __m128i __v) {
+#ifdef __x86_64__
+  return crc32c_u64_sse4(crc32c_u64_sse4(crc, _mm_cvtsi128_si64(__v)),
+                         _mm_extract_epi64(__v, 1));
+#else
+  _Alignas(__m128i) uint64_t v[2];
+  _mm_store_si128((__m128i *)v, __v);
+  return crc32c_u64_sse4(crc32c_u64_sse4(crc, v[0]), v[1]);
 #endif
+}
 
-#ifdef __AVX2__
+uint32_t cl_crc32c_sse4(const uint32_t crc, const void *buf, size_t size) {
+  const uint8_t *p = (const uint8_t *)buf;
+  uint32_t crc_state = ~crc;
+  for (; size >= sizeof(uint64_t);
+       p += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    crc_state = crc32c_u64_sse4(crc_state, v);
+  }
+  for (; size; ++p, --size)
+    crc_state = _mm_crc32_u8(crc_state, *p);
+  return ~crc_state;
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_sse4(uint8_t *src_buf,
+                                                    const size_t src_size,
+                                                    const cl_op_chain_t *chain,
+                                                    cl_stats_t *stats,
+                                                    uint32_t *crc) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_sse4_inline(
+      src_buf, src_size, apply_op_chain_opt_stats_sse4_inline,
+      apply_op_chain_opt_stats_inline, &sctx, crc32c_sse4_inline, crc);
+}
+
+TARGET_POP
+#endif
+
+#ifdef CL_ARCH_X86
+TARGET_PUSH("avx2")
 
 static inline int u8_buf_12bit_encoded_transform_inplace_avx2_inline(
-    uint8_t *src_buf, size_t src_size, __m256i (*transform_fn_avx)(__m256i),
-    void (*transform_fn_scalar)(uint16_t[8])) {
+    uint8_t *src_buf, size_t src_size,
+    __m256i (*transform_fn_avx)(__m256i, const void *),
+    void (*transform_fn_scalar)(uint16_t[8], const void *), const void *ctx,
+    uint32_t (*crc_fn_avx)(uint32_t, __m256i), uint32_t *crc) {
   if (!src_size)
     return CL_SUCCESS;
   if ((size_t)src_buf & (sizeof(__m256i) - 1))
@@ -1143,6 +2259,7 @@ static inline int u8_buf_12bit_encoded_transform_inplace_avx2_inline(
       6, -1, 0, 2, 8, 10, -1, 4, -1, 12, 14, -1, -1, -1, -1, -1, 6, -1, 0, 2, 8,
       10, -1, 4, -1, 12, 14, -1, -1, -1, -1, -1);
 
+  uint32_t crc_state = (crc != NULL) ? ~*crc : 0;
   for (size_t i_src = 0; i_src < (src_size - (12 * 8 - 1)); i_src += 12 * 8) {
 
     const __m256i __v0 = _mm256_load_si256((const __m256i *)&src_buf[i_src]);
@@ -1150,11 +2267,13 @@ static inline int u8_buf_12bit_encoded_transform_inplace_avx2_inline(
     const __m128i __v01 = _mm256_extracti128_si256(__v0, 1);
 
     const __m256i __v0_res = _mm256_epu16_to_12bit_encoded_epu8(
-        transform_fn_avx(_mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(_mm256_castsi128_si256(__v00),
-                                    _mm_alignr_epi8(__v01, __v00, 12), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb)),
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(_mm256_castsi128_si256(__v00),
+                                        _mm_alignr_epi8(__v01, __v00, 12), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
@@ -1164,22 +2283,25 @@ static inline int u8_buf_12bit_encoded_transform_inplace_avx2_inline(
     const __m128i __v11 = _mm256_extracti128_si256(__v1, 1);
 
     const __m256i __v1_res = _mm256_epu16_to_12bit_encoded_epu8(
-        transform_fn_avx(_mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(
-                _mm256_castsi128_si256(_mm_alignr_epi8(__v10, __v01, 8)),
-                _mm_srli_si128(__v10, 4), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb)),
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(
+                    _mm256_castsi128_si256(_mm_alignr_epi8(__v10, __v01, 8)),
+                    _mm_srli_si128(__v10, 4), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
-    _mm256_store_si256(
-        (__m256i *)&src_buf[i_src],
-        _mm256_or_si256(__v0_res,
-                        _mm256_inserti128_si256(
-                            _mm256_setzero_si256(),
-                            _mm_slli_si128(_mm256_castsi256_si128(__v1_res), 8),
-                            1)));
+    const __m256i __o0 = _mm256_or_si256(
+        __v0_res,
+        _mm256_inserti128_si256(
+            _mm256_setzero_si256(),
+            _mm_slli_si128(_mm256_castsi256_si128(__v1_res), 8), 1));
+    _mm256_store_si256((__m256i *)&src_buf[i_src], __o0);
+    if (crc != NULL)
+      crc_state = crc_fn_avx(crc_state, __o0);
 
     const __m256i __v2 =
         _mm256_load_si256((const __m256i *)&src_buf[i_src + 64]);
@@ -1187,57 +2309,72 @@ static inline int u8_buf_12bit_encoded_transform_inplace_avx2_inline(
     const __m128i __v21 = _mm256_extracti128_si256(__v2, 1);
 
     const __m256i __v2_res = _mm256_epu16_to_12bit_encoded_epu8(
-        transform_fn_avx(_mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(_mm256_castsi128_si256(__v11),
-                                    _mm_alignr_epi8(__v20, __v11, 12), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb)),
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(_mm256_castsi128_si256(__v11),
+                                        _mm_alignr_epi8(__v20, __v11, 12), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
-    _mm256_store_si256(
-        (__m256i *)&src_buf[i_src + 32],
+    const __m256i __o1 =
         _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_alignr_epi8(
                                     _mm256_extracti128_si256(__v1_res, 1),
                                     _mm256_castsi256_si128(__v1_res), 8)),
-                                _mm256_castsi256_si128(__v2_res), 1));
+                                _mm256_castsi256_si128(__v2_res), 1);
+    _mm256_store_si256((__m256i *)&src_buf[i_src + 32], __o1);
+    if (crc != NULL)
+      crc_state = crc_fn_avx(crc_state, __o1);
 
     const __m256i __v3_res = _mm256_epu16_to_12bit_encoded_epu8(
-        transform_fn_avx(_mm256_12bit_encoded_epu8_to_epu16(
-            _mm256_insertf128_si256(
-                _mm256_castsi128_si256(_mm_alignr_epi8(__v21, __v20, 8)),
-                _mm_srli_si128(__v21, 4), 1),
-            __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
-            __and_mask_lb)),
+        transform_fn_avx(
+            _mm256_12bit_encoded_epu8_to_epu16(
+                _mm256_insertf128_si256(
+                    _mm256_castsi128_si256(_mm_alignr_epi8(__v21, __v20, 8)),
+                    _mm_srli_si128(__v21, 4), 1),
+                __shuffle_mask_hb, __shuffle_mask_lb, __and_mask_hb,
+                __and_mask_lb),
+            ctx),
         __dst_and_mask_hb, __dst_and_mask_lb, __dst_shuffle_mask_hb,
         __dst_shuffle_mask_lb);
 
-    _mm256_store_si256(
-        (__m256i *)&src_buf[i_src + 64],
-        _mm256_inserti128_si256(
-            _mm256_castsi128_si256(_mm_or_si128(
-                _mm256_extracti128_si256(__v2_res, 1),
-                _mm_slli_si128(_mm256_castsi256_si128(__v3_res), 8))),
-            _mm_or_si128(
-                _mm_srli_si128(_mm256_castsi256_si128(__v3_res), 8),
-                _mm_slli_si128(_mm256_extracti128_si256(__v3_res, 1), 8)),
-            1));
+    const __m256i __o2 = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_or_si128(
+            _mm256_extracti128_si256(__v2_res, 1),
+            _mm_slli_si128(_mm256_castsi256_si128(__v3_res), 8))),
+        _mm_or_si128(_mm_srli_si128(_mm256_castsi256_si128(__v3_res), 8),
+                     _mm_slli_si128(_mm256_extracti128_si256(__v3_res, 1), 8)),
+        1);
+    _mm256_store_si256((__m256i *)&src_buf[i_src + 64], __o2);
+    if (crc != NULL)
+      crc_state = crc_fn_avx(crc_state, __o2);
   }
+  if (crc != NULL)
+    *crc = ~crc_state;
 
   if (src_size_cut) {
   done:
-    return u8_buf_12bit_encoded_transform_inplace_scalar(
-        &src_buf[src_size], src_size_cut, transform_fn_scalar);
+    return u8_buf_12bit_encoded_transform_inplace_scalar_inline(
+        &src_buf[src_size], src_size_cut, transform_fn_scalar, ctx, crc);
   }
 
   return CL_SUCCESS;
 }
 
+static __m256i call_transform_fn_avx2(__m256i __p, const void *ctx) {
+  return ((const transform_fns_t *)ctx)->avx(__p);
+}
+
 int u8_buf_12bit_encoded_transform_inplace_avx2(
     uint8_t *src_buf, size_t src_size, __m256i (*transform_fn_avx)(__m256i),
     void (*transform_fn_scalar)(uint16_t[8])) {
+  const transform_fns_t fns = {.avx = transform_fn_avx,
+                               .scalar = transform_fn_scalar};
   return u8_buf_12bit_encoded_transform_inplace_avx2_inline(
-      src_buf, src_size, transform_fn_avx, transform_fn_scalar);
+      src_buf, src_size, call_transform_fn_avx2, call_transform_fn_scalar,
+      &fns, NULL, NULL);
 }
 
 /**
@@ -1282,7 +2419,9 @@ static inline __m256i _mm256_srlv_epi16x(__m256i __a, __m256i __count) {
   _mm256_cmpgt_epi16(_mm256_xor_si256(a, _mm256_set1_epi16(0x8000)),           \
                      _mm256_xor_si256(b, _mm256_set1_epi16(0x8000)))
 
-static inline __m256i to_log_encoded_12bit_avx2_inline(__m256i __p) {
+static inline __m256i to_log_encoded_12bit_avx2_inline(__m256i __p,
+                                                       const void *ctx) {
+  (void)ctx;
   __p = _mm256_slli_epi16(__p, 4);
   const __m256i __q =
       _mm256_sub_epi16(_mm256_bsr_epi16(__p), _mm256_set1_epi16(9));
@@ -1296,7 +2435,456 @@ int u8_buf_12bit_encoded_to_log_encoded_12bit_avx2(uint8_t *src_buf,
                                                    const size_t src_size) {
   return u8_buf_12bit_encoded_transform_inplace_avx2_inline(
       src_buf, src_size, to_log_encoded_12bit_avx2_inline,
-      to_log_encoded_12bit_inline);
+      to_log_encoded_12bit_inline, NULL, NULL, NULL);
+}
+
+static inline __m256i _mm256_lut_epu16(const uint16_t *lut, __m256i __p) {
+  const __m256i __lo_mask = _mm256_set1_epi32(0x0000FFFF);
+  // every 32 bit lane gathers lut[i] | (lut[i + 1] << 16)
+  const __m256i __lo = _mm256_and_si256(
+      _mm256_i32gather_epi32((const int *)lut,
+                             _mm256_cvtepu16_epi32(_mm256_castsi256_si128(__p)),
+                             sizeof(uint16_t)),
+      __lo_mask);
+  const __m256i __hi = _mm256_and_si256(
+      _mm256_i32gather_epi32(
+          (const int *)lut,
+          _mm256_cvtepu16_epi32(_mm256_extracti128_si256(__p, 1)),
+          sizeof(uint16_t)),
+      __lo_mask);
+  // packus works per 128 bit lane
+  return _mm256_permute4x64_epi64(_mm256_packus_epi32(__lo, __hi),
+                                  0b11011000);
+}
+
+static inline __m256i apply_curve_avx2_inline(__m256i __p, const void *ctx) {
+  return _mm256_lut_epu16(((const cl_curve_t *)ctx)->lut, __p);
+}
+
+int u8_buf_12bit_encoded_apply_curve_avx2(uint8_t *src_buf,
+                                          const size_t src_size,
+                                          const cl_curve_t *curve) {
+  return u8_buf_12bit_encoded_transform_inplace_avx2_inline(
+      src_buf, src_size, apply_curve_avx2_inline, apply_curve_inline, curve,
+      NULL, NULL);
+}
+
+int u8_buf_log_encoded_12bit_to_u16_avx2(const uint8_t *src_buf,
+                                         const size_t src_size,
+                                         uint16_t *dst_buf,
+                                         const size_t dst_size) {
+  return u8_buf_12bit_encoded_to_u16_avx2_inline(
+      src_buf, src_size, dst_buf, dst_size, apply_curve_avx2_inline,
+      apply_curve_inline, &log_decoded_16bit_curve, false);
+}
+
+int u8_buf_log_encoded_12bit_to_linear_12bit_avx2(uint8_t *src_buf,
+                                                  const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_avx2(src_buf, src_size,
+                                               &log_decoded_12bit_curve);
+}
+
+static inline __m256i apply_op_chain_avx2_inline(__m256i __p, const void *ctx) {
+  const cl_op_chain_t *chain = (const cl_op_chain_t *)ctx;
+  for (size_t i = 0; i < chain->n_ops; ++i) {
+    const struct cl_op_chain_op *op = &chain->ops[i];
+    const __m256i __arg = _mm256_load_si256((const __m256i *)op->arg);
+    switch (op->type) {
+    case CL_OP_BLACK_LEVEL:
+      __p = _mm256_subs_epu16(__p, __arg);
+      break;
+    case CL_OP_GAIN:
+      __p = _mm256_min_epu16(
+          _mm256_mulhi_epu16(_mm256_slli_epi16(__p, 16 - GAIN_FRAC_BITS),
+                             __arg),
+          _mm256_set1_epi16(MAX_12BIT));
+      break;
+    case CL_OP_CLAMP:
+      __p = _mm256_min_epu16(__p, __arg);
+      break;
+    default: // CL_OP_CURVE, CL_OP_LOG_ENCODE
+      __p = apply_curve_avx2_inline(__p, op->curve);
+      break;
+    }
+  }
+  return __p;
 }
 
+int u8_buf_12bit_encoded_apply_op_chain_avx2(uint8_t *src_buf,
+                                             const size_t src_size,
+                                             const cl_op_chain_t *chain) {
+  return u8_buf_12bit_encoded_transform_inplace_avx2_inline(
+      src_buf, src_size, apply_op_chain_avx2_inline, apply_op_chain_inline,
+      chain, NULL, NULL);
+}
+
+static inline __m256i stats_add_avx2_inline(cl_stats_t *stats, __m256i __p) {
+  _Alignas(__m256i) uint16_t p_buf[16];
+  _mm256_store_si256((__m256i *)p_buf, __p);
+  stats_add_inline(stats, p_buf);
+  stats_add_inline(stats, &p_buf[8]);
+  return __p;
+}
+
+static inline __m256i apply_op_chain_stats_avx2_inline(__m256i __p,
+                                                       const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  return stats_add_avx2_inline(sctx->stats,
+                               apply_op_chain_avx2_inline(__p, sctx->ctx));
+}
+
+static inline __m256i identity_stats_avx2_inline(__m256i __p, const void *ctx) {
+  return stats_add_avx2_inline(((const struct stats_ctx *)ctx)->stats, __p);
+}
+
+static inline __m256i apply_op_chain_opt_stats_avx2_inline(__m256i __p,
+                                                           const void *ctx) {
+  const struct stats_ctx *sctx = (const struct stats_ctx *)ctx;
+  __p = apply_op_chain_avx2_inline(__p, sctx->ctx);
+  return (sctx->stats != NULL) ? stats_add_avx2_inline(sctx->stats, __p) : __p;
+}
+
+int u8_buf_12bit_encoded_to_u16_stats_avx2(const uint8_t *src_buf,
+                                           const size_t src_size,
+                                           uint16_t *dst_buf,
+                                           const size_t dst_size,
+                                           cl_stats_t *stats) {
+  const struct stats_ctx sctx = {NULL, stats};
+  return u8_buf_12bit_encoded_to_u16_avx2_inline(
+      src_buf, src_size, dst_buf, dst_size, identity_stats_avx2_inline,
+      identity_stats_inline, &sctx, false);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_stats_avx2(uint8_t *src_buf,
+                                                   const size_t src_size,
+                                                   const cl_op_chain_t *chain,
+                                                   cl_stats_t *stats) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_avx2_inline(
+      src_buf, src_size, apply_op_chain_stats_avx2_inline,
+      apply_op_chain_stats_inline, &sctx, NULL, NULL);
+}
+
+// AVX2 implies SSE4.2, so the crc32 instruction as well
+static inline uint32_t crc32c_avx2_inline(const uint32_t crc, __m256i __v) {
+  return crc32c_sse4_inline(
+      crc32c_sse4_inline(crc, _mm256_castsi256_si128(__v)),
+      _mm256_extracti128_si256(__v, 1));
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_avx2(uint8_t *src_buf,
+                                                    const size_t src_size,
+                                                    const cl_op_chain_t *chain,
+                                                    cl_stats_t *stats,
+                                                    uint32_t *crc) {
+  const struct stats_ctx sctx = {chain, stats};
+  return u8_buf_12bit_encoded_transform_inplace_avx2_inline(
+      src_buf, src_size, apply_op_chain_opt_stats_avx2_inline,
+      apply_op_chain_opt_stats_inline, &sctx, crc32c_avx2_inline, crc);
+}
+
+int u8_buf_12bit_encoded_to_log_encoded_12bit_lut_avx2(uint8_t *src_buf,
+                                                       const size_t src_size) {
+  return u8_buf_12bit_encoded_apply_curve_avx2(src_buf, src_size,
+                                               &log_encoded_12bit_curve);
+}
+
+TARGET_POP
 #endif
+
+static const char *const isa_names[] = {
+    "scalar", // CL_ISA_SCALAR
+    "SSE4",   // CL_ISA_SSE4
+    "AVX2",   // CL_ISA_AVX2
+    "NEON",   // CL_ISA_NEON
+};
+
+const char *cl_isa_name(int isa) {
+  if (isa < 0 || (unsigned int)isa >= (sizeof(isa_names) / sizeof(char *)))
+    return NULL;
+  return isa_names[isa];
+}
+
+void *cl_alloc_huge(size_t size) {
+  // aligned_alloc requires a multiple of the alignment
+  size = (size + CL_HUGE_PAGE_SIZE - 1) & ~(size_t)(CL_HUGE_PAGE_SIZE - 1);
+  void *buf = aligned_alloc(CL_HUGE_PAGE_SIZE, size ? size : CL_HUGE_PAGE_SIZE);
+#ifdef __linux__
+  // only advice, with THP disabled the buffer keeps its 4 KiB pages
+  if (buf != NULL)
+    madvise(buf, size, MADV_HUGEPAGE);
+#endif
+  return buf;
+}
+
+typedef struct cl_dispatch {
+  int isa;
+  int (*u8_buf_12bit_encoded_to_u16)(const uint8_t *, size_t, uint16_t *,
+                                     size_t);
+  int (*u16_buf_to_u8_12bit_encoded)(const uint16_t *, size_t, uint8_t *,
+                                     size_t);
+  int (*u8_buf_12bit_encoded_to_u16_stream)(const uint8_t *, size_t,
+                                            uint16_t *, size_t);
+  int (*u16_buf_to_u8_12bit_encoded_stream)(const uint16_t *, size_t,
+                                            uint8_t *, size_t);
+  int (*u8_buf_12bit_encoded_to_log_encoded_12bit)(uint8_t *, size_t);
+  int (*u8_buf_12bit_encoded_apply_curve)(uint8_t *, size_t,
+                                          const cl_curve_t *);
+  int (*u8_buf_log_encoded_12bit_to_u16)(const uint8_t *, size_t, uint16_t *,
+                                         size_t);
+  int (*u8_buf_log_encoded_12bit_to_linear_12bit)(uint8_t *, size_t);
+  int (*u8_buf_12bit_encoded_apply_op_chain)(uint8_t *, size_t,
+                                             const cl_op_chain_t *);
+  int (*u8_buf_12bit_encoded_to_u16_stats)(const uint8_t *, size_t,
+                                           uint16_t *, size_t, cl_stats_t *);
+  int (*u8_buf_12bit_encoded_apply_op_chain_stats)(uint8_t *, size_t,
+                                                   const cl_op_chain_t *,
+                                                   cl_stats_t *);
+  uint32_t (*crc32c)(uint32_t, const void *, size_t);
+  int (*u8_buf_12bit_encoded_apply_op_chain_crc32c)(uint8_t *, size_t,
+                                                    const cl_op_chain_t *,
+                                                    cl_stats_t *, uint32_t *);
+} cl_dispatch_t;
+
+// NEON is part of the aarch64 baseline, so only x86-64 needs to ask the CPU
+// the log encoding defaults to the table lookup on x86-64, in the
+// raw_converter_test benchmark it beat the bsr + variable shift on every ISA
+// (NEON has a native clz and variable shift, so it keeps the arithmetic)
+static cl_dispatch_t dispatch = {
+#ifdef __aarch64__
+    .isa = CL_ISA_NEON,
+    .u8_buf_12bit_encoded_to_u16 = u8_buf_12bit_encoded_to_u16_neon,
+    .u16_buf_to_u8_12bit_encoded = u16_buf_to_u8_12bit_encoded_neon,
+    .u8_buf_12bit_encoded_to_u16_stream =
+        u8_buf_12bit_encoded_to_u16_stream_neon,
+    .u16_buf_to_u8_12bit_encoded_stream =
+        u16_buf_to_u8_12bit_encoded_stream_neon,
+    .u8_buf_12bit_encoded_to_log_encoded_12bit =
+        u8_buf_12bit_encoded_to_log_encoded_12bit_neon,
+    .u8_buf_12bit_encoded_apply_curve = u8_buf_12bit_encoded_apply_curve_neon,
+    .u8_buf_log_encoded_12bit_to_u16 = u8_buf_log_encoded_12bit_to_u16_neon,
+    .u8_buf_log_encoded_12bit_to_linear_12bit =
+        u8_buf_log_encoded_12bit_to_linear_12bit_neon,
+    .u8_buf_12bit_encoded_apply_op_chain =
+        u8_buf_12bit_encoded_apply_op_chain_neon,
+    .u8_buf_12bit_encoded_to_u16_stats =
+        u8_buf_12bit_encoded_to_u16_stats_neon,
+    .u8_buf_12bit_encoded_apply_op_chain_stats =
+        u8_buf_12bit_encoded_apply_op_chain_stats_neon,
+    .crc32c = cl_crc32c_neon,
+    .u8_buf_12bit_encoded_apply_op_chain_crc32c =
+        u8_buf_12bit_encoded_apply_op_chain_crc32c_neon,
+#else
+    .isa = CL_ISA_SCALAR,
+    .u8_buf_12bit_encoded_to_u16 = u8_buf_12bit_encoded_to_u16_scalar,
+    .u16_buf_to_u8_12bit_encoded = u16_buf_to_u8_12bit_encoded_scalar,
+    // plain C has no non-temporal stores
+    .u8_buf_12bit_encoded_to_u16_stream = u8_buf_12bit_encoded_to_u16_scalar,
+    .u16_buf_to_u8_12bit_encoded_stream = u16_buf_to_u8_12bit_encoded_scalar,
+    .u8_buf_12bit_encoded_to_log_encoded_12bit =
+        u8_buf_12bit_encoded_to_log_encoded_12bit_lut_scalar,
+    .u8_buf_12bit_encoded_apply_curve = u8_buf_12bit_encoded_apply_curve_scalar,
+    .u8_buf_log_encoded_12bit_to_u16 = u8_buf_log_encoded_12bit_to_u16_scalar,
+    .u8_buf_log_encoded_12bit_to_linear_12bit =
+        u8_buf_log_encoded_12bit_to_linear_12bit_scalar,
+    .u8_buf_12bit_encoded_apply_op_chain =
+        u8_buf_12bit_encoded_apply_op_chain_scalar,
+    .u8_buf_12bit_encoded_to_u16_stats =
+        u8_buf_12bit_encoded_to_u16_stats_scalar,
+    .u8_buf_12bit_encoded_apply_op_chain_stats =
+        u8_buf_12bit_encoded_apply_op_chain_stats_scalar,
+    .crc32c = cl_crc32c_scalar,
+    .u8_buf_12bit_encoded_apply_op_chain_crc32c =
+        u8_buf_12bit_encoded_apply_op_chain_crc32c_scalar,
+#endif
+};
+
+// only used when the cache size can NOT be queried
+#define LLC_SIZE_DEFAULT (8 * 1024 * 1024)
+
+static size_t stream_threshold = LLC_SIZE_DEFAULT;
+
+static size_t llc_size(void) {
+  long size = -1;
+#if defined(_SC_LEVEL3_CACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+  // glibc reports 0 for a cache level the CPU does NOT have
+  if ((size = sysconf(_SC_LEVEL3_CACHE_SIZE)) <= 0)
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#elif defined(__APPLE__)
+  // apple silicon has no L3, its shared L2 is the last level
+  int64_t value;
+  size_t len = sizeof(value);
+  if (!sysctlbyname("hw.l3cachesize", &value, &len, NULL, 0) ||
+      !sysctlbyname("hw.l2cachesize", &value, &len, NULL, 0))
+    size = (long)value;
+#endif
+  return (size > 0) ? (size_t)size : LLC_SIZE_DEFAULT;
+}
+
+__attribute__((constructor)) static void cl_dispatch_init(void) {
+  log_encoded_12bit_curves_init();
+  crc32c_table_init();
+  crc32c_x2n_table_init();
+  stream_threshold = llc_size();
+#ifdef CL_ARCH_X86
+  // constructors may run before libgcc initialized its cpu model
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    dispatch = (cl_dispatch_t){
+        .isa = CL_ISA_AVX2,
+        .u8_buf_12bit_encoded_to_u16 = u8_buf_12bit_encoded_to_u16_avx2,
+        .u16_buf_to_u8_12bit_encoded = u16_buf_to_u8_12bit_encoded_avx2,
+        .u8_buf_12bit_encoded_to_u16_stream =
+            u8_buf_12bit_encoded_to_u16_stream_avx2,
+        .u16_buf_to_u8_12bit_encoded_stream =
+            u16_buf_to_u8_12bit_encoded_stream_avx2,
+        .u8_buf_12bit_encoded_to_log_encoded_12bit =
+            u8_buf_12bit_encoded_to_log_encoded_12bit_lut_avx2,
+        .u8_buf_12bit_encoded_apply_curve =
+            u8_buf_12bit_encoded_apply_curve_avx2,
+        .u8_buf_log_encoded_12bit_to_u16 =
+            u8_buf_log_encoded_12bit_to_u16_avx2,
+        .u8_buf_log_encoded_12bit_to_linear_12bit =
+            u8_buf_log_encoded_12bit_to_linear_12bit_avx2,
+        .u8_buf_12bit_encoded_apply_op_chain =
+            u8_buf_12bit_encoded_apply_op_chain_avx2,
+        .u8_buf_12bit_encoded_to_u16_stats =
+            u8_buf_12bit_encoded_to_u16_stats_avx2,
+        .u8_buf_12bit_encoded_apply_op_chain_stats =
+            u8_buf_12bit_encoded_apply_op_chain_stats_avx2,
+        .crc32c = cl_crc32c_sse4,
+        .u8_buf_12bit_encoded_apply_op_chain_crc32c =
+            u8_buf_12bit_encoded_apply_op_chain_crc32c_avx2,
+    };
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    dispatch = (cl_dispatch_t){
+        .isa = CL_ISA_SSE4,
+        .u8_buf_12bit_encoded_to_u16 = u8_buf_12bit_encoded_to_u16_sse4,
+        .u16_buf_to_u8_12bit_encoded = u16_buf_to_u8_12bit_encoded_sse4,
+        .u8_buf_12bit_encoded_to_u16_stream =
+            u8_buf_12bit_encoded_to_u16_stream_sse4,
+        .u16_buf_to_u8_12bit_encoded_stream =
+            u16_buf_to_u8_12bit_encoded_stream_sse4,
+        .u8_buf_12bit_encoded_to_log_encoded_12bit =
+            u8_buf_12bit_encoded_to_log_encoded_12bit_lut_sse4,
+        .u8_buf_12bit_encoded_apply_curve =
+            u8_buf_12bit_encoded_apply_curve_sse4,
+        .u8_buf_log_encoded_12bit_to_u16 =
+            u8_buf_log_encoded_12bit_to_u16_sse4,
+        .u8_buf_log_encoded_12bit_to_linear_12bit =
+            u8_buf_log_encoded_12bit_to_linear_12bit_sse4,
+        .u8_buf_12bit_encoded_apply_op_chain =
+            u8_buf_12bit_encoded_apply_op_chain_sse4,
+        .u8_buf_12bit_encoded_to_u16_stats =
+            u8_buf_12bit_encoded_to_u16_stats_sse4,
+        .u8_buf_12bit_encoded_apply_op_chain_stats =
+            u8_buf_12bit_encoded_apply_op_chain_stats_sse4,
+        // the few SSE4.1 CPUs without SSE4.2 checksum through the table
+        .crc32c = cl_crc32c_scalar,
+        .u8_buf_12bit_encoded_apply_op_chain_crc32c =
+            u8_buf_12bit_encoded_apply_op_chain_crc32c_scalar,
+    };
+    if (__builtin_cpu_supports("sse4.2")) {
+      dispatch.crc32c = cl_crc32c_sse4;
+      dispatch.u8_buf_12bit_encoded_apply_op_chain_crc32c =
+          u8_buf_12bit_encoded_apply_op_chain_crc32c_sse4;
+    }
+  }
+#endif
+}
+
+int cl_isa(void) { return dispatch.isa; }
+
+size_t cl_stream_threshold(void) { return stream_threshold; }
+
+void cl_set_stream_threshold(size_t size) { stream_threshold = size; }
+
+// an output larger than the LLC is evicted before anyone reads it again,
+// streaming it keeps the source (and everything else) cached instead
+int u8_buf_12bit_encoded_to_u16(const uint8_t *src_buf, size_t src_size,
+                                uint16_t *dst_buf, size_t dst_size) {
+  if (ENCODED_TO_DECODED_SIZE(src_size) * sizeof(uint16_t) >= stream_threshold)
+    return dispatch.u8_buf_12bit_encoded_to_u16_stream(src_buf, src_size,
+                                                       dst_buf, dst_size);
+  return dispatch.u8_buf_12bit_encoded_to_u16(src_buf, src_size, dst_buf,
+                                              dst_size);
+}
+
+int u16_buf_to_u8_12bit_encoded(const uint16_t *src_buf, size_t src_size,
+                                uint8_t *dst_buf, size_t dst_size) {
+  if (DECODED_TO_ENCODED_SIZE(src_size) >= stream_threshold)
+    return dispatch.u16_buf_to_u8_12bit_encoded_stream(src_buf, src_size,
+                                                       dst_buf, dst_size);
+  return dispatch.u16_buf_to_u8_12bit_encoded(src_buf, src_size, dst_buf,
+                                              dst_size);
+}
+
+int u8_buf_12bit_encoded_to_log_encoded_12bit(uint8_t *src_buf,
+                                              size_t src_size) {
+  return dispatch.u8_buf_12bit_encoded_to_log_encoded_12bit(src_buf, src_size);
+}
+
+int u8_buf_12bit_encoded_apply_curve(uint8_t *src_buf, size_t src_size,
+                                     const cl_curve_t *curve) {
+  return dispatch.u8_buf_12bit_encoded_apply_curve(src_buf, src_size, curve);
+}
+
+int u8_buf_log_encoded_12bit_to_u16(const uint8_t *src_buf, size_t src_size,
+                                    uint16_t *dst_buf, size_t dst_size) {
+  return dispatch.u8_buf_log_encoded_12bit_to_u16(src_buf, src_size, dst_buf,
+                                                  dst_size);
+}
+
+int u8_buf_log_encoded_12bit_to_linear_12bit(uint8_t *src_buf,
+                                             size_t src_size) {
+  return dispatch.u8_buf_log_encoded_12bit_to_linear_12bit(src_buf, src_size);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain(uint8_t *src_buf, size_t src_size,
+                                        const cl_op_chain_t *chain) {
+  return dispatch.u8_buf_12bit_encoded_apply_op_chain(src_buf, src_size,
+                                                      chain);
+}
+
+int u8_buf_12bit_encoded_to_u16_stats(const uint8_t *src_buf, size_t src_size,
+                                      uint16_t *dst_buf, size_t dst_size,
+                                      cl_stats_t *stats) {
+  return dispatch.u8_buf_12bit_encoded_to_u16_stats(src_buf, src_size, dst_buf,
+                                                    dst_size, stats);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_stats(uint8_t *src_buf,
+                                              size_t src_size,
+                                              const cl_op_chain_t *chain,
+                                              cl_stats_t *stats) {
+  return dispatch.u8_buf_12bit_encoded_apply_op_chain_stats(src_buf, src_size,
+                                                            chain, stats);
+}
+
+int u8_buf_12bit_encoded_to_log_encoded_12bit_stats(uint8_t *src_buf,
+                                                    size_t src_size,
+                                                    cl_stats_t *stats) {
+  return dispatch.u8_buf_12bit_encoded_apply_op_chain_stats(
+      src_buf, src_size, &log_encoded_12bit_op_chain, stats);
+}
+
+uint32_t cl_crc32c(uint32_t crc, const void *buf, size_t size) {
+  return dispatch.crc32c(crc, buf, size);
+}
+
+int u8_buf_12bit_encoded_apply_op_chain_crc32c(uint8_t *src_buf,
+                                               size_t src_size,
+                                               const cl_op_chain_t *chain,
+                                               cl_stats_t *stats,
+                                               uint32_t *crc) {
+  return dispatch.u8_buf_12bit_encoded_apply_op_chain_crc32c(
+      src_buf, src_size, chain, stats, crc);
+}
+
+int u8_buf_12bit_encoded_to_log_encoded_12bit_crc32c(uint8_t *src_buf,
+                                                     size_t src_size,
+                                                     cl_stats_t *stats,
+                                                     uint32_t *crc) {
+  return dispatch.u8_buf_12bit_encoded_apply_op_chain_crc32c(
+      src_buf, src_size, &log_encoded_12bit_op_chain, stats, crc);
+}
@@ -22,7 +22,11 @@
 #include <inttypes.h>
 #include <stdlib.h>
 
-#if defined(__SSE4_1__) || defined(__AVX2__)
+#if defined(__x86_64__) || defined(__i386__)
+#define CL_ARCH_X86
+#endif
+
+#ifdef CL_ARCH_X86
 #include <emmintrin.h>
 #include <immintrin.h>
 #include <smmintrin.h>
@@ -41,6 +45,29 @@
 #define CL_ERR_SBUF_A32 -5
 #define CL_ERR_DBUF_A32 -6
 #define CL_ERR_SBUF_DIV_8 -7
+#define CL_ERR_CURVE_SIZE -8
+#define CL_ERR_CURVE_RANGE -9
+#define CL_ERR_CURVE_PARAMS -10
+#define CL_ERR_ALLOC -11
+#define CL_ERR_OP_CHAIN -12
+
+#define CL_ISA_SCALAR 0
+#define CL_ISA_SSE4 1
+#define CL_ISA_AVX2 2
+#define CL_ISA_NEON 3
+
+#define CL_CURVE_LOG 0
+#define CL_CURVE_GAMMA 1
+
+#define CL_OP_BLACK_LEVEL 0
+#define CL_OP_GAIN 1
+#define CL_OP_CLAMP 2
+#define CL_OP_CURVE 3
+#define CL_OP_LOG_ENCODE 4
+
+#define CL_OP_CHAIN_MAX 16
+
+#define CL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,6 +75,36 @@ extern "C" {
 
 const char *cl_error_message_from_return_code(int return_code);
 
+/**
+ * returns the instruction set (CL_ISA_*) of the kernels the dispatching
+ * functions (without _scalar/_sse4/_avx2/_neon suffix) were bound to.
+ * the binding is resolved once at startup by querying the CPU (cpuid),
+ * so a generic build still runs the fastest kernels the host supports.
+ **/
+int cl_isa(void);
+const char *cl_isa_name(int isa);
+
+/**
+ * allocates a buffer aligned to CL_HUGE_PAGE_SIZE (so it fits the alignment
+ * of every kernel) and backs it with transparent huge pages where the
+ * system supports them (MADV_HUGEPAGE), large buffers suffer fewer TLB misses
+ * IMPORTANT: returns NULL on error, free the buffer with free
+ **/
+void *cl_alloc_huge(size_t size);
+
+/**
+ * output size in bytes from which on the dispatching
+ * u8_buf_12bit_encoded_to_u16 and u16_buf_to_u8_12bit_encoded switch to their
+ * _stream variants, defaults to the size of the last level cache (queried once
+ * at startup)
+ **/
+size_t cl_stream_threshold(void);
+/**
+ * IMPORTANT: NOT thread safe, set it before any conversion runs
+ * IMPORTANT: 0 streams every conversion, SIZE_MAX never streams
+ **/
+void cl_set_stream_threshold(size_t size);
+
 /**
  * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
  *                                            or ((src_size / 3) * 4) bytes
@@ -66,7 +123,21 @@ int u8_buf_12bit_encoded_to_u16_neon(const uint8_t *src_buf, size_t src_size,
                                      uint16_t *dst_buf, size_t dst_size);
 #endif
 
-#ifdef __SSE4_1__
+#ifdef __aarch64__
+/**
+ * same result as u8_buf_12bit_encoded_to_u16_neon, but writes dst_buf with
+ * non-temporal stores that bypass the caches (for buffers larger than the LLC)
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_12bit_encoded_to_u16_stream_neon(const uint8_t *src_buf,
+                                            size_t src_size, uint16_t *dst_buf,
+                                            size_t dst_size);
+#endif
+
+#ifdef CL_ARCH_X86
 /**
  * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
  * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
@@ -77,7 +148,21 @@ int u8_buf_12bit_encoded_to_u16_sse4(const uint8_t *src_buf, size_t src_size,
                                      uint16_t *dst_buf, size_t dst_size);
 #endif
 
-#ifdef __AVX2__
+#ifdef CL_ARCH_X86
+/**
+ * same result as u8_buf_12bit_encoded_to_u16_sse4, but writes dst_buf with
+ * non-temporal stores that bypass the caches (for buffers larger than the LLC)
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_12bit_encoded_to_u16_stream_sse4(const uint8_t *src_buf,
+                                            size_t src_size, uint16_t *dst_buf,
+                                            size_t dst_size);
+#endif
+
+#ifdef CL_ARCH_X86
 /**
  * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
  * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
@@ -88,21 +173,28 @@ int u8_buf_12bit_encoded_to_u16_avx2(const uint8_t *src_buf, size_t src_size,
                                      uint16_t *dst_buf, size_t dst_size);
 #endif
 
+#ifdef CL_ARCH_X86
 /**
+ * same result as u8_buf_12bit_encoded_to_u16_avx2, but writes dst_buf with
+ * non-temporal stores that bypass the caches (for buffers larger than the LLC)
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
  * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
  *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
  **/
-inline int u8_buf_12bit_encoded_to_u16(const uint8_t *src_buf, size_t src_size,
-                                       uint16_t *dst_buf, size_t dst_size) {
-#ifdef __AVX2__
-  return u8_buf_12bit_encoded_to_u16_avx2(src_buf, src_size, dst_buf, dst_size);
-#elif defined(__SSE4_1__)
-  return u8_buf_12bit_encoded_to_u16_sse4(src_buf, src_size, dst_buf, dst_size);
-#else
-  return u8_buf_12bit_encoded_to_u16_scalar(src_buf, src_size, dst_buf,
-                                            dst_size);
+int u8_buf_12bit_encoded_to_u16_stream_avx2(const uint8_t *src_buf,
+                                            size_t src_size, uint16_t *dst_buf,
+                                            size_t dst_size);
 #endif
-}
+
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: streams the output from cl_stream_threshold() bytes on
+ **/
+int u8_buf_12bit_encoded_to_u16(const uint8_t *src_buf, size_t src_size,
+                                uint16_t *dst_buf, size_t dst_size);
 
 /**
  * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
@@ -122,7 +214,21 @@ int u16_buf_to_u8_12bit_encoded_neon(const uint16_t *src_buf, size_t src_size,
                                      uint8_t *dst_buf, size_t dst_size);
 #endif
 
-#ifdef __SSE4_1__
+#ifdef __aarch64__
+/**
+ * same result as u16_buf_to_u8_12bit_encoded_neon, but writes dst_buf with
+ * non-temporal stores that bypass the caches (for buffers larger than the LLC)
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
+ *                                                                   (bytes)
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u16_buf_to_u8_12bit_encoded_stream_neon(const uint16_t *src_buf,
+                                            size_t src_size, uint8_t *dst_buf,
+                                            size_t dst_size);
+#endif
+
+#ifdef CL_ARCH_X86
 /**
  * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
  * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
@@ -133,7 +239,21 @@ int u16_buf_to_u8_12bit_encoded_sse4(const uint16_t *src_buf, size_t src_size,
                                      uint8_t *dst_buf, size_t dst_size);
 #endif
 
-#ifdef __AVX2__
+#ifdef CL_ARCH_X86
+/**
+ * same result as u16_buf_to_u8_12bit_encoded_sse4, but writes dst_buf with
+ * non-temporal stores that bypass the caches (for buffers larger than the LLC)
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
+ *                                                                   (bytes)
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u16_buf_to_u8_12bit_encoded_stream_sse4(const uint16_t *src_buf,
+                                            size_t src_size, uint8_t *dst_buf,
+                                            size_t dst_size);
+#endif
+
+#ifdef CL_ARCH_X86
 /**
  * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
  * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
@@ -144,21 +264,28 @@ int u16_buf_to_u8_12bit_encoded_avx2(const uint16_t *src_buf, size_t src_size,
                                      uint8_t *dst_buf, size_t dst_size);
 #endif
 
+#ifdef CL_ARCH_X86
 /**
+ * same result as u16_buf_to_u8_12bit_encoded_avx2, but writes dst_buf with
+ * non-temporal stores that bypass the caches (for buffers larger than the LLC)
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
  * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
  *                                                                   (bytes)
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
  **/
-inline int u16_buf_to_u8_12bit_encoded(const uint16_t *src_buf, size_t src_size,
-                                       uint8_t *dst_buf, size_t dst_size) {
-#ifdef __AVX2__
-  return u16_buf_to_u8_12bit_encoded_avx2(src_buf, src_size, dst_buf, dst_size);
-#elif defined(__SSE4_1__)
-  return u16_buf_to_u8_12bit_encoded_sse4(src_buf, src_size, dst_buf, dst_size);
-#else
-  return u16_buf_to_u8_12bit_encoded_scalar(src_buf, src_size, dst_buf,
-                                            dst_size);
+int u16_buf_to_u8_12bit_encoded_stream_avx2(const uint16_t *src_buf,
+                                            size_t src_size, uint8_t *dst_buf,
+                                            size_t dst_size);
 #endif
-}
+
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 2) * 3) elements
+ *                                                                   (bytes)
+ * IMPORTANT: streams the output from cl_stream_threshold() bytes on
+ **/
+int u16_buf_to_u8_12bit_encoded(const uint16_t *src_buf, size_t src_size,
+                                uint8_t *dst_buf, size_t dst_size);
 
 int u8_buf_12bit_encoded_transform_inplace_scalar(
     uint8_t *src_buf, size_t src_size, void (*transform_fn)(uint16_t[8]));
@@ -166,6 +293,13 @@ int u8_buf_12bit_encoded_transform_inplace_scalar(
 int u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(uint8_t *src_buf,
                                                      size_t src_size);
 
+/**
+ * same result as u8_buf_12bit_encoded_to_log_encoded_12bit_scalar,
+ * but looks the curve up in a precomputed 4096 entry table
+ **/
+int u8_buf_12bit_encoded_to_log_encoded_12bit_lut_scalar(uint8_t *src_buf,
+                                                         size_t src_size);
+
 #ifdef __aarch64__
 /**
  * IMPORTANT: src_buf must be aligned to 16 bytes
@@ -186,7 +320,7 @@ int u8_buf_12bit_encoded_to_log_encoded_12bit_neon(uint8_t *src_buf,
                                                    size_t src_size);
 #endif
 
-#ifdef __SSE4_1__
+#ifdef CL_ARCH_X86
 /**
  * IMPORTANT: src_buf must be aligned to 16 bytes
  * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
@@ -203,9 +337,16 @@ int u8_buf_12bit_encoded_transform_inplace_sse4(
  **/
 int u8_buf_12bit_encoded_to_log_encoded_12bit_sse4(uint8_t *src_buf,
                                                    size_t src_size);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_12bit_encoded_to_log_encoded_12bit_lut_sse4(uint8_t *src_buf,
+                                                       size_t src_size);
 #endif
 
-#ifdef __AVX2__
+#ifdef CL_ARCH_X86
 /**
  * IMPORTANT: src_buf must be aligned to 32 bytes
  * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
@@ -222,23 +363,485 @@ int u8_buf_12bit_encoded_transform_inplace_avx2(
  **/
 int u8_buf_12bit_encoded_to_log_encoded_12bit_avx2(uint8_t *src_buf,
                                                    size_t src_size);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_12bit_encoded_to_log_encoded_12bit_lut_avx2(uint8_t *src_buf,
+                                                       size_t src_size);
 #endif
 
-static inline int u8_buf_12bit_encoded_to_log_encoded_12bit(uint8_t *src_buf,
-                                                            size_t src_size) {
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_to_log_encoded_12bit(uint8_t *src_buf,
+                                              size_t src_size);
+
+/**
+ * a precompiled 12 bit -> 12 bit tone curve (4096 entry lookup table)
+ * which is applied by the same single pass in-place engine as the log encoding
+ **/
+typedef struct cl_curve cl_curve_t;
+
+/**
+ * linear (out = in * slope) below knee, above knee the remaining input range
+ * [knee, 4095] is mapped onto [knee * slope, 4095] by
+ * CL_CURVE_LOG: a log2 curve
+ * CL_CURVE_GAMMA: a power curve with exponent 1 / gamma
+ * e.g. {CL_CURVE_GAMMA, 0, 0.0, 2.2} is a plain 2.2 gamma encoding
+ **/
+typedef struct cl_curve_params {
+  int type;
+  uint16_t knee;
+  double slope;
+  double gamma;
+} cl_curve_params_t;
+
+/**
+ * IMPORTANT: table_size must be 4096 and every value must fit into 12 bits
+ * IMPORTANT: free the curve with cl_curve_free
+ **/
+int cl_curve_from_table(cl_curve_t **curve, const uint16_t *table,
+                        size_t table_size);
+
+/**
+ * IMPORTANT: free the curve with cl_curve_free
+ **/
+int cl_curve_from_params(cl_curve_t **curve, const cl_curve_params_t *params);
+
+void cl_curve_free(cl_curve_t *curve);
+
+/**
+ * returns the 4096 entry lookup table of the curve
+ **/
+const uint16_t *cl_curve_table(const cl_curve_t *curve);
+
+int u8_buf_12bit_encoded_apply_curve_scalar(uint8_t *src_buf, size_t src_size,
+                                            const cl_curve_t *curve);
+
 #ifdef __aarch64__
-  return u8_buf_12bit_encoded_to_log_encoded_12bit_neon(src_buf, src_size);
-#elif defined(__AVX2__)
-  return u8_buf_12bit_encoded_to_log_encoded_12bit_avx2(src_buf, src_size);
-#elif defined(__SSE4_1__)
-  return u8_buf_12bit_encoded_to_log_encoded_12bit_sse4(src_buf, src_size);
-#else
-  return u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(src_buf, src_size);
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_12bit_encoded_apply_curve_neon(uint8_t *src_buf, size_t src_size,
+                                          const cl_curve_t *curve);
 #endif
-}
+
+#ifdef CL_ARCH_X86
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_12bit_encoded_apply_curve_sse4(uint8_t *src_buf, size_t src_size,
+                                          const cl_curve_t *curve);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_12bit_encoded_apply_curve_avx2(uint8_t *src_buf, size_t src_size,
+                                          const cl_curve_t *curve);
+#endif
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_apply_curve(uint8_t *src_buf, size_t src_size,
+                                     const cl_curve_t *curve);
+
+/**
+ * inverse of the log encoding: unpacks log encoded 12 bit data into linear
+ * 16 bit values, log -> linear -> log round trips bit exactly
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ **/
+int u8_buf_log_encoded_12bit_to_u16_scalar(const uint8_t *src_buf,
+                                           size_t src_size, uint16_t *dst_buf,
+                                           size_t dst_size);
+
+/**
+ * in-place inverse of the log encoding (linear values truncated to 12 bit)
+ **/
+int u8_buf_log_encoded_12bit_to_linear_12bit_scalar(uint8_t *src_buf,
+                                                    size_t src_size);
+
+#ifdef __aarch64__
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_log_encoded_12bit_to_u16_neon(const uint8_t *src_buf,
+                                         size_t src_size, uint16_t *dst_buf,
+                                         size_t dst_size);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_log_encoded_12bit_to_linear_12bit_neon(uint8_t *src_buf,
+                                                  size_t src_size);
+#endif
+
+#ifdef CL_ARCH_X86
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_log_encoded_12bit_to_u16_sse4(const uint8_t *src_buf,
+                                         size_t src_size, uint16_t *dst_buf,
+                                         size_t dst_size);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_log_encoded_12bit_to_linear_12bit_sse4(uint8_t *src_buf,
+                                                  size_t src_size);
+
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_log_encoded_12bit_to_u16_avx2(const uint8_t *src_buf,
+                                         size_t src_size, uint16_t *dst_buf,
+                                         size_t dst_size);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_log_encoded_12bit_to_linear_12bit_avx2(uint8_t *src_buf,
+                                                  size_t src_size);
+#endif
+
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ **/
+int u8_buf_log_encoded_12bit_to_u16(const uint8_t *src_buf, size_t src_size,
+                                    uint16_t *dst_buf, size_t dst_size);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_log_encoded_12bit_to_linear_12bit(uint8_t *src_buf,
+                                             size_t src_size);
+
+/**
+ * one step of a per pixel operation chain, the per channel arguments are
+ * indexed {G, R} (even pixels are G, odd pixels are R)
+ * CL_OP_BLACK_LEVEL: out = max(in - value, 0)
+ * CL_OP_GAIN: out = min(in * gain, 4095), 0 <= gain < 16
+ * CL_OP_CLAMP: out = min(in, value)
+ * CL_OP_CURVE: out = curve(in)
+ * CL_OP_LOG_ENCODE: same as u8_buf_12bit_encoded_to_log_encoded_12bit
+ **/
+typedef struct cl_op {
+  int type;
+  uint16_t value[2];
+  double gain[2];
+  const cl_curve_t *curve;
+} cl_op_t;
+
+/**
+ * a compiled sequence of up to CL_OP_CHAIN_MAX ops, applied in order
+ * to the unpacked pixels of the in-place engine, so the whole chain costs
+ * a single read and write of the buffer
+ **/
+typedef struct cl_op_chain cl_op_chain_t;
+
+/**
+ * IMPORTANT: the curves of CL_OP_CURVE ops are NOT copied,
+ *            they must outlive the chain
+ * IMPORTANT: free the chain with cl_op_chain_free
+ **/
+int cl_op_chain_create(cl_op_chain_t **chain, const cl_op_t *ops,
+                       size_t n_ops);
+
+void cl_op_chain_free(cl_op_chain_t *chain);
+
+int u8_buf_12bit_encoded_apply_op_chain_scalar(uint8_t *src_buf,
+                                               size_t src_size,
+                                               const cl_op_chain_t *chain);
+
+#ifdef __aarch64__
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_neon(uint8_t *src_buf,
+                                             size_t src_size,
+                                             const cl_op_chain_t *chain);
+#endif
+
+#ifdef CL_ARCH_X86
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_sse4(uint8_t *src_buf,
+                                             size_t src_size,
+                                             const cl_op_chain_t *chain);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_avx2(uint8_t *src_buf,
+                                             size_t src_size,
+                                             const cl_op_chain_t *chain);
+#endif
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_apply_op_chain(uint8_t *src_buf, size_t src_size,
+                                        const cl_op_chain_t *chain);
+
+#define CL_CHANNEL_G 0
+#define CL_CHANNEL_R 1
+
+/**
+ * statistics sink of the *_stats kernels, accumulates the per channel
+ * 4096 bin histograms of the 12 bit pixels the kernels write
+ * IMPORTANT: a sink is NOT thread safe, use one sink per thread and merge
+ *            them with cl_stats_merge
+ **/
+typedef struct cl_stats cl_stats_t;
+
+typedef struct cl_channel_stats {
+  uint64_t hist[4096];
+  uint64_t count;
+  uint16_t min;
+  uint16_t max;
+  double mean;
+} cl_channel_stats_t;
+
+/**
+ * IMPORTANT: free the sink with cl_stats_free
+ **/
+int cl_stats_create(cl_stats_t **stats);
+
+void cl_stats_free(cl_stats_t *stats);
+
+void cl_stats_reset(cl_stats_t *stats);
+
+void cl_stats_merge(cl_stats_t *dst, const cl_stats_t *src);
+
+/**
+ * min, max and mean are derived from the histogram,
+ * they are 0 if the channel is empty
+ **/
+void cl_stats_channel(const cl_stats_t *stats, int channel,
+                      cl_channel_stats_t *channel_stats);
+
+/**
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ **/
+int u8_buf_12bit_encoded_to_u16_stats_scalar(const uint8_t *src_buf,
+                                             size_t src_size, uint16_t *dst_buf,
+                                             size_t dst_size,
+                                             cl_stats_t *stats);
+
+int u8_buf_12bit_encoded_apply_op_chain_stats_scalar(
+    uint8_t *src_buf, size_t src_size, const cl_op_chain_t *chain,
+    cl_stats_t *stats);
+
+#ifdef __aarch64__
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_12bit_encoded_to_u16_stats_neon(const uint8_t *src_buf,
+                                           size_t src_size, uint16_t *dst_buf,
+                                           size_t dst_size, cl_stats_t *stats);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_stats_neon(uint8_t *src_buf,
+                                                   size_t src_size,
+                                                   const cl_op_chain_t *chain,
+                                                   cl_stats_t *stats);
+#endif
+
+#ifdef CL_ARCH_X86
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 16 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_12bit_encoded_to_u16_stats_sse4(const uint8_t *src_buf,
+                                           size_t src_size, uint16_t *dst_buf,
+                                           size_t dst_size, cl_stats_t *stats);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.1
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_stats_sse4(uint8_t *src_buf,
+                                                   size_t src_size,
+                                                   const cl_op_chain_t *chain,
+                                                   cl_stats_t *stats);
+
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_12bit_encoded_to_u16_stats_avx2(const uint8_t *src_buf,
+                                           size_t src_size, uint16_t *dst_buf,
+                                           size_t dst_size, cl_stats_t *stats);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_stats_avx2(uint8_t *src_buf,
+                                                   size_t src_size,
+                                                   const cl_op_chain_t *chain,
+                                                   cl_stats_t *stats);
+#endif
+
+/**
+ * IMPORTANT: src_buf and dst_buf must be aligned to 32 bytes
+ * IMPORTANT: dst_buf must have size of at least ((src_size / 3) * 2) elements
+ *                                            or ((src_size / 3) * 4) bytes
+ **/
+int u8_buf_12bit_encoded_to_u16_stats(const uint8_t *src_buf, size_t src_size,
+                                      uint16_t *dst_buf, size_t dst_size,
+                                      cl_stats_t *stats);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_stats(uint8_t *src_buf,
+                                              size_t src_size,
+                                              const cl_op_chain_t *chain,
+                                              cl_stats_t *stats);
+
+/**
+ * the log encoding with the statistics of the log encoded pixels
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_to_log_encoded_12bit_stats(uint8_t *src_buf,
+                                                    size_t src_size,
+                                                    cl_stats_t *stats);
+
+/**
+ * CRC32C (Castagnoli, as in iSCSI and ext4) of the size bytes of buf,
+ * zlib style: crc is the CRC of the preceding bytes (0 before the first),
+ * so a buffer can be checksummed piece by piece.
+ * the dispatched cl_crc32c uses the crc32 instruction of SSE4.2 or ARMv8
+ **/
+uint32_t cl_crc32c(uint32_t crc, const void *buf, size_t size);
+
+uint32_t cl_crc32c_scalar(uint32_t crc, const void *buf, size_t size);
+
+#ifdef __aarch64__
+/**
+ * IMPORTANT: only supported on aarch64 CPUs, without the CRC extension
+ *            at compile time (__ARM_FEATURE_CRC32) it falls back to the table
+ **/
+uint32_t cl_crc32c_neon(uint32_t crc, const void *buf, size_t size);
+#endif
+
+#ifdef CL_ARCH_X86
+/**
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.2
+ **/
+uint32_t cl_crc32c_sse4(uint32_t crc, const void *buf, size_t size);
+#endif
+
+/**
+ * CRC32C of two consecutive pieces from the CRC of each piece and the size
+ * of the second one, so the pieces can be checksummed concurrently and in
+ * any order
+ **/
+uint32_t cl_crc32c_combine(uint32_t crc1, uint32_t crc2, size_t size2);
+
+/**
+ * the op chain that updates *crc with the CRC32C of the output on the fly,
+ * the output is checksummed while it is still in the registers, which saves
+ * reading the buffer a second time. *crc is the CRC of the output preceding
+ * src_buf (0 before the first buffer).
+ * the statistics of the output are accumulated into stats (if NOT NULL)
+ * IMPORTANT: crc must NOT be NULL
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_scalar(
+    uint8_t *src_buf, size_t src_size, const cl_op_chain_t *chain,
+    cl_stats_t *stats, uint32_t *crc);
+
+#ifdef __aarch64__
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on aarch64 CPUs
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_neon(uint8_t *src_buf,
+                                                    size_t src_size,
+                                                    const cl_op_chain_t *chain,
+                                                    cl_stats_t *stats,
+                                                    uint32_t *crc);
+#endif
+
+#ifdef CL_ARCH_X86
+/**
+ * IMPORTANT: src_buf must be aligned to 16 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >SSE4.2
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_sse4(uint8_t *src_buf,
+                                                    size_t src_size,
+                                                    const cl_op_chain_t *chain,
+                                                    cl_stats_t *stats,
+                                                    uint32_t *crc);
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ * IMPORTANT: only supported on x86-64 CPUs with feature >AVX2
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_crc32c_avx2(uint8_t *src_buf,
+                                                    size_t src_size,
+                                                    const cl_op_chain_t *chain,
+                                                    cl_stats_t *stats,
+                                                    uint32_t *crc);
+#endif
+
+/**
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_apply_op_chain_crc32c(uint8_t *src_buf,
+                                               size_t src_size,
+                                               const cl_op_chain_t *chain,
+                                               cl_stats_t *stats,
+                                               uint32_t *crc);
+
+/**
+ * the log encoding with the CRC32C (and the statistics, if stats is NOT NULL)
+ * of the log encoded pixels
+ * IMPORTANT: src_buf must be aligned to 32 bytes
+ **/
+int u8_buf_12bit_encoded_to_log_encoded_12bit_crc32c(uint8_t *src_buf,
+                                                     size_t src_size,
+                                                     cl_stats_t *stats,
+                                                     uint32_t *crc);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -20,10 +20,71 @@
 #include "timer.h"
 #include <assert.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+static cl_curve_t *test_curve = NULL;
+static cl_op_chain_t *test_op_chain = NULL;
+static cl_stats_t *test_stats = NULL;
+static cl_op_t test_ops[] = {
+    {CL_OP_BLACK_LEVEL, {64, 96}, {0.0, 0.0}, NULL},
+    {CL_OP_GAIN, {0, 0}, {1.5, 2.25}, NULL},
+    {CL_OP_CLAMP, {4000, 3800}, {0.0, 0.0}, NULL},
+    {CL_OP_CURVE, {0, 0}, {0.0, 0.0}, NULL}, // test_curve
+    {CL_OP_LOG_ENCODE, {0, 0}, {0.0, 0.0}, NULL},
+};
+
+// the big buffers are backed by huge pages, the kernels touch every page of
+// the buffers and would spend a measurable time on TLB misses otherwise
+static void *test_alloc(size_t alignment, size_t size) {
+  if (size >= CL_HUGE_PAGE_SIZE)
+    return cl_alloc_huge(size);
+  return aligned_alloc(alignment, size);
+}
+
+// compares the sink against the histograms of the (unpacked) pixels in buf
+int check_stats(const cl_stats_t *stats, const uint16_t *buf, size_t size,
+                const char *name) {
+  static cl_channel_stats_t channel_stats;
+  static uint64_t hist[2][4096];
+  memset(hist, 0, sizeof(hist));
+  for (size_t i = 0; i < size; ++i)
+    ++hist[i & 1][buf[i]];
+  for (int ch = CL_CHANNEL_G; ch <= CL_CHANNEL_R; ++ch) {
+    cl_stats_channel(stats, ch, &channel_stats);
+    uint64_t count = 0, sum = 0;
+    uint16_t min = 0, max = 0;
+    for (size_t v = 0; v < 4096; ++v) {
+      if (hist[ch][v] != channel_stats.hist[v]) {
+        printf("Channel: %d, Bin: %lu, Value reference: %lu, Value stats %s: "
+               "%lu\n",
+               ch, v, hist[ch][v], name, channel_stats.hist[v]);
+        return -1;
+      }
+      if (!hist[ch][v])
+        continue;
+      if (!count)
+        min = v;
+      max = v;
+      count += hist[ch][v];
+      sum += hist[ch][v] * v;
+    }
+    const double mean = count ? (double)sum / count : 0.0;
+    if (count != channel_stats.count || min != channel_stats.min ||
+        max != channel_stats.max || mean != channel_stats.mean) {
+      printf("Channel: %d, Stats reference: %lu %u %u %f, Stats %s: %lu %u %u "
+             "%f\n",
+             ch, count, min, max, mean, name, channel_stats.count,
+             channel_stats.min, channel_stats.max, channel_stats.mean);
+      return -1;
+    }
+  }
+  return 0;
+}
 
 int run_test(const size_t buf_size, size_t src_alloc_size,
              size_t dst_alloc_size) {
@@ -34,22 +95,24 @@ int run_test(const size_t buf_size, size_t src_alloc_size,
   const size_t src_buf_size = buf_size;
   src_alloc_size = (src_alloc_size != 0) ? src_alloc_size : src_buf_size;
 
-  uint8_t *src_buf = (uint8_t *)aligned_alloc(32, src_alloc_size);
+  uint8_t *src_buf = (uint8_t *)test_alloc(32, src_alloc_size);
   assert(src_buf != NULL);
   uint8_t *src_buf_test = (uint8_t *)malloc(src_alloc_size);
   assert(src_buf_test != NULL);
 #ifdef __SSE4_1__
-  uint8_t *src_buf_test_sse = (uint8_t *)aligned_alloc(16, src_alloc_size);
+  uint8_t *src_buf_test_sse = (uint8_t *)test_alloc(16, src_alloc_size);
   assert(src_buf_test_sse != NULL);
 #endif
 #ifdef __aarch64__
-  uint8_t *src_buf_test_neon = (uint8_t *)aligned_alloc(16, src_alloc_size);
+  uint8_t *src_buf_test_neon = (uint8_t *)test_alloc(16, src_alloc_size);
   assert(src_buf_test_neon != NULL);
 #endif
 #ifdef __AVX2__
-  uint8_t *src_buf_test_avx = (uint8_t *)aligned_alloc(32, src_alloc_size);
+  uint8_t *src_buf_test_avx = (uint8_t *)test_alloc(32, src_alloc_size);
   assert(src_buf_test_avx != NULL);
 #endif
+  uint8_t *src_buf_test_lut = (uint8_t *)test_alloc(32, src_alloc_size);
+  assert(src_buf_test_lut != NULL);
   for (size_t i = 0; i < src_buf_size; ++i) {
     int r = rand();
     src_buf[i] = r;
@@ -72,17 +135,17 @@ int run_test(const size_t buf_size, size_t src_alloc_size,
   assert(dst_buf != NULL);
 #ifdef __aarch64__
   uint16_t *dst_buf_neon =
-      (uint16_t *)aligned_alloc(16, sizeof(uint16_t) * dst_alloc_size);
+      (uint16_t *)test_alloc(16, sizeof(uint16_t) * dst_alloc_size);
   assert(dst_buf_neon != NULL);
 #endif
 #ifdef __SSE4_1__
   uint16_t *dst_buf_sse =
-      (uint16_t *)aligned_alloc(16, sizeof(uint16_t) * dst_alloc_size);
+      (uint16_t *)test_alloc(16, sizeof(uint16_t) * dst_alloc_size);
   assert(dst_buf_sse != NULL);
 #endif
 #ifdef __AVX2__
   uint16_t *dst_buf_avx =
-      (uint16_t *)aligned_alloc(32, sizeof(uint16_t) * dst_alloc_size);
+      (uint16_t *)test_alloc(32, sizeof(uint16_t) * dst_alloc_size);
   assert(dst_buf_avx != NULL);
 #endif
   for (size_t i = 0; i < (dst_buf_size >> 1); ++i) {
@@ -251,6 +314,94 @@ int run_test(const size_t buf_size, size_t src_alloc_size,
     }
   }
 #endif
+
+  printf("\nu8_buf_12bit_encoded_to_u16_stream\n");
+
+  // the _stream variants rewrite the verified SIMD buffers with the same values
+#ifdef __aarch64__
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stream_neon(
+           src_buf, src_buf_size, dst_buf_neon, dst_buf_size)) < 0 ||
+      (ret = u16_buf_to_u8_12bit_encoded_stream_neon(
+           dst_buf_neon, dst_buf_size, src_buf_test_neon, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_neon = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time NEON: %ldns\n", elapsed_neon);
+#endif
+
+#ifdef __SSE4_1__
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stream_sse4(
+           src_buf, src_buf_size, dst_buf_sse, dst_buf_size)) < 0 ||
+      (ret = u16_buf_to_u8_12bit_encoded_stream_sse4(
+           dst_buf_sse, dst_buf_size, src_buf_test_sse, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_sse4 = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time SSE4: %ldns\n", elapsed_sse4);
+#endif
+
+#ifdef __AVX2__
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stream_avx2(
+           src_buf, src_buf_size, dst_buf_avx, dst_buf_size)) < 0 ||
+      (ret = u16_buf_to_u8_12bit_encoded_stream_avx2(
+           dst_buf_avx, dst_buf_size, src_buf_test_avx, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_avx2 = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time AVX2: %ldns\n", elapsed_avx2);
+
+  // a zero threshold sends the dispatching functions down the _stream path
+  const size_t stream_threshold = cl_stream_threshold();
+  cl_set_stream_threshold(0);
+  ret = u8_buf_12bit_encoded_to_u16(src_buf, src_buf_size, dst_buf_avx,
+                                    dst_buf_size);
+  if (ret >= 0)
+    ret = u16_buf_to_u8_12bit_encoded(dst_buf_avx, dst_buf_size,
+                                      src_buf_test_avx, src_buf_size);
+  cl_set_stream_threshold(stream_threshold);
+  if (ret < 0)
+    goto error;
+#endif
+
+  for (size_t i = 0; i < (dst_buf_size >> 1); ++i) {
+    if (0
+#ifdef __aarch64__
+        || dst_buf_neon[i] != dst_buf[i]
+#endif
+#ifdef __SSE4_1__
+        || dst_buf_sse[i] != dst_buf[i]
+#endif
+#ifdef __AVX2__
+        || dst_buf_avx[i] != dst_buf[i]
+#endif
+    ) {
+      printf("Index: %lu, Value normal: %u, streamed value differs\n", i,
+             dst_buf[i]);
+      if (++error_counter > 32)
+        goto error;
+    }
+  }
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (0
+#ifdef __aarch64__
+        || src_buf_test_neon[i] != src_buf[i]
+#endif
+#ifdef __SSE4_1__
+        || src_buf_test_sse[i] != src_buf[i]
+#endif
+#ifdef __AVX2__
+        || src_buf_test_avx[i] != src_buf[i]
+#endif
+    ) {
+      printf("Index: %lu, Value normal: %u, streamed value differs\n", i,
+             src_buf[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
   printf("\nu8_buf_12bit_encoded_to_log_encoded_12bit\n");
 
   restart_high_resolution_timer(&timer);
@@ -327,9 +478,772 @@ int run_test(const size_t buf_size, size_t src_alloc_size,
   }
 #endif
 
+  printf("\nu8_buf_12bit_encoded_to_log_encoded_12bit (LUT)\n");
+
+  // src_buf still holds the input of the log encoding above
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_lut_scalar(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  long elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time LUT normal: %ldns\n", elapsed_lut);
+
+  printf("Delta LUT normal: %ldns\n", elapsed_lut - elapsed_normal);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value normal: %u, Value LUT normal: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+
+#ifdef __SSE4_1__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_lut_sse4(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time LUT SSE4: %ldns\n", elapsed_lut);
+
+  printf("Delta LUT SSE4: %ldns\n", elapsed_lut - elapsed_sse4);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value normal: %u, Value LUT SSE4: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __AVX2__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_lut_avx2(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time LUT AVX2: %ldns\n", elapsed_lut);
+
+  printf("Delta LUT AVX2: %ldns\n", elapsed_lut - elapsed_avx2);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value normal: %u, Value LUT AVX2: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+  printf("\nu8_buf_12bit_encoded_apply_curve\n");
+
+  // reference: decoded pixels (dst_buf) -> curve table -> encode
+  const uint16_t *curve_table = cl_curve_table(test_curve);
+  for (size_t i = 0; i < dst_buf_size; ++i)
+    dst_buf[i] = curve_table[dst_buf[i]];
+  if ((ret = u16_buf_to_u8_12bit_encoded_scalar(dst_buf, dst_buf_size,
+                                                src_buf_test, src_buf_size)) <
+      0) {
+    goto error;
+  }
+
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_curve_scalar(
+           src_buf_test_lut, src_buf_size, test_curve)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time curve normal: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value curve normal: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+
+#ifdef __SSE4_1__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_curve_sse4(
+           src_buf_test_lut, src_buf_size, test_curve)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time curve SSE4: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value curve SSE4: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __AVX2__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_curve_avx2(
+           src_buf_test_lut, src_buf_size, test_curve)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time curve AVX2: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value curve AVX2: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __aarch64__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_curve_neon(
+           src_buf_test_lut, src_buf_size, test_curve)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time curve NEON: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value curve NEON: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+  printf("\nu8_buf_12bit_encoded_apply_op_chain\n");
+
+  // reference: every op of the chain as its own pass over the decoded pixels
+  if ((ret = u8_buf_12bit_encoded_to_u16_scalar(src_buf, src_buf_size, dst_buf,
+                                                dst_buf_size)) < 0) {
+    goto error;
+  }
+  for (size_t op = 0; op < sizeof(test_ops) / sizeof(cl_op_t); ++op) {
+    for (size_t i = 0; i < dst_buf_size; ++i) {
+      const size_t ch = i & 1;
+      const uint16_t v = dst_buf[i];
+      switch (test_ops[op].type) {
+      case CL_OP_BLACK_LEVEL:
+        dst_buf[i] = (v > test_ops[op].value[ch]) ? v - test_ops[op].value[ch]
+                                                  : 0;
+        break;
+      case CL_OP_GAIN:
+        dst_buf[i] = (v * test_ops[op].gain[ch] > 4095.0)
+                         ? 4095
+                         : (uint16_t)(v * test_ops[op].gain[ch]);
+        break;
+      case CL_OP_CLAMP:
+        dst_buf[i] = (v > test_ops[op].value[ch]) ? test_ops[op].value[ch] : v;
+        break;
+      case CL_OP_CURVE:
+        dst_buf[i] = cl_curve_table(test_ops[op].curve)[v];
+        break;
+      }
+    }
+  }
+  if ((ret = u16_buf_to_u8_12bit_encoded_scalar(dst_buf, dst_buf_size,
+                                                src_buf_test, src_buf_size)) <
+      0) {
+    goto error;
+  }
+  // the chain ends with the log encoding
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(
+           src_buf_test, src_buf_size)) < 0) {
+    goto error;
+  }
+
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_scalar(
+           src_buf_test_lut, src_buf_size, test_op_chain)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain normal: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value op chain normal: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+
+#ifdef __SSE4_1__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_sse4(
+           src_buf_test_lut, src_buf_size, test_op_chain)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain SSE4: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value op chain SSE4: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __AVX2__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_avx2(
+           src_buf_test_lut, src_buf_size, test_op_chain)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain AVX2: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value op chain AVX2: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __aarch64__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_neon(
+           src_buf_test_lut, src_buf_size, test_op_chain)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain NEON: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value op chain NEON: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+  printf("\nu8_buf_12bit_encoded_apply_op_chain_stats\n");
+
+  // reference: histograms of the unpacked op chain output
+  if ((ret = u8_buf_12bit_encoded_to_u16_scalar(src_buf_test, src_buf_size,
+                                                dst_buf, dst_buf_size)) < 0) {
+    goto error;
+  }
+
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_stats_scalar(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain stats normal: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value stats normal: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "normal") < 0)
+    goto error;
+
+#ifdef __SSE4_1__
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_stats_sse4(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain stats SSE4: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value stats SSE4: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "SSE4") < 0)
+    goto error;
+#endif
+
+#ifdef __AVX2__
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_stats_avx2(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain stats AVX2: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value stats AVX2: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "AVX2") < 0)
+    goto error;
+#endif
+
+#ifdef __aarch64__
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_stats_neon(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain stats NEON: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value stats NEON: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "NEON") < 0)
+    goto error;
+#endif
+
+  printf("\nu8_buf_12bit_encoded_apply_op_chain_crc32c\n");
+
+  // reference: the checksum of the op chain output in a separate pass
+  const uint32_t crc_ref = cl_crc32c_scalar(0, src_buf_test, src_buf_size);
+  uint32_t crc = 0;
+
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_crc32c_scalar(
+           src_buf_test_lut, src_buf_size, test_op_chain, NULL, &crc)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain crc32c normal: %ldns\n", elapsed_lut);
+
+  if (crc != crc_ref || memcmp(src_buf_test, src_buf_test_lut, src_buf_size)) {
+    printf("CRC32C reference: %08x, CRC32C normal: %08x\n", crc_ref, crc);
+    goto error;
+  }
+
+#ifdef __SSE4_2__
+  crc = 0;
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_crc32c_sse4(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats, &crc)) <
+      0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain crc32c SSE4: %ldns\n", elapsed_lut);
+
+  if (crc != crc_ref || memcmp(src_buf_test, src_buf_test_lut, src_buf_size)) {
+    printf("CRC32C reference: %08x, CRC32C SSE4: %08x\n", crc_ref, crc);
+    goto error;
+  }
+  if (cl_crc32c_sse4(0, src_buf_test, src_buf_size) != crc_ref) {
+    printf("CRC32C reference: %08x, cl_crc32c SSE4 differs\n", crc_ref);
+    goto error;
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "crc32c SSE4") < 0)
+    goto error;
+#endif
+
+#ifdef __AVX2__
+  crc = 0;
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_crc32c_avx2(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats, &crc)) <
+      0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain crc32c AVX2: %ldns\n", elapsed_lut);
+
+  if (crc != crc_ref || memcmp(src_buf_test, src_buf_test_lut, src_buf_size)) {
+    printf("CRC32C reference: %08x, CRC32C AVX2: %08x\n", crc_ref, crc);
+    goto error;
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "crc32c AVX2") < 0)
+    goto error;
+#endif
+
+#ifdef __aarch64__
+  crc = 0;
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_apply_op_chain_crc32c_neon(
+           src_buf_test_lut, src_buf_size, test_op_chain, test_stats, &crc)) <
+      0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time op chain crc32c NEON: %ldns\n", elapsed_lut);
+
+  if (crc != crc_ref || memcmp(src_buf_test, src_buf_test_lut, src_buf_size)) {
+    printf("CRC32C reference: %08x, CRC32C NEON: %08x\n", crc_ref, crc);
+    goto error;
+  }
+  if (cl_crc32c_neon(0, src_buf_test, src_buf_size) != crc_ref) {
+    printf("CRC32C reference: %08x, cl_crc32c NEON differs\n", crc_ref);
+    goto error;
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "crc32c NEON") < 0)
+    goto error;
+#endif
+
+  // the dispatched kernel continues the CRC of the first piece, the pieces
+  // checksummed on their own are combined instead
+  {
+    const size_t split = src_buf_size / 2 / 96 * 96;
+    uint32_t crc_tail = 0;
+    crc = 0;
+    memcpy(src_buf_test_lut, src_buf, src_buf_size);
+    if ((ret = u8_buf_12bit_encoded_apply_op_chain_crc32c(
+             src_buf_test_lut, split, test_op_chain, NULL, &crc)) < 0 ||
+        (ret = u8_buf_12bit_encoded_apply_op_chain_crc32c(
+             &src_buf_test_lut[split], src_buf_size - split, test_op_chain,
+             NULL, &crc)) < 0) {
+      goto error;
+    }
+    if (crc != crc_ref) {
+      printf("CRC32C reference: %08x, CRC32C dispatched: %08x\n", crc_ref,
+             crc);
+      goto error;
+    }
+    crc = cl_crc32c(0, src_buf_test, split);
+    crc_tail = cl_crc32c(0, &src_buf_test[split], src_buf_size - split);
+    if (cl_crc32c_combine(crc, crc_tail, src_buf_size - split) != crc_ref) {
+      printf("CRC32C reference: %08x, combined CRC32C differs\n", crc_ref);
+      goto error;
+    }
+  }
+
+  printf("\nu8_buf_12bit_encoded_to_u16_stats\n");
+
+  cl_stats_reset(test_stats);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stats_scalar(
+           src_buf, src_buf_size, dst_buf, dst_buf_size, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time unpack stats normal: %ldns\n", elapsed_lut);
+
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "normal") < 0)
+    goto error;
+
+#ifdef __SSE4_1__
+  cl_stats_reset(test_stats);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stats_sse4(
+           src_buf, src_buf_size, dst_buf_sse, dst_buf_size, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time unpack stats SSE4: %ldns\n", elapsed_lut);
+
+  if (check_stats(test_stats, dst_buf_sse, dst_buf_size, "SSE4") < 0)
+    goto error;
+#endif
+
+#ifdef __AVX2__
+  cl_stats_reset(test_stats);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stats_avx2(
+           src_buf, src_buf_size, dst_buf_avx, dst_buf_size, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time unpack stats AVX2: %ldns\n", elapsed_lut);
+
+  if (check_stats(test_stats, dst_buf_avx, dst_buf_size, "AVX2") < 0)
+    goto error;
+#endif
+
+#ifdef __aarch64__
+  cl_stats_reset(test_stats);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_u16_stats_neon(
+           src_buf, src_buf_size, dst_buf_neon, dst_buf_size, test_stats)) <
+      0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time unpack stats NEON: %ldns\n", elapsed_lut);
+
+  if (check_stats(test_stats, dst_buf_neon, dst_buf_size, "NEON") < 0)
+    goto error;
+#endif
+
+  printf("\nu8_buf_12bit_encoded_to_log_encoded_12bit_stats\n");
+
+  memcpy(src_buf_test, src_buf, src_buf_size);
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(
+           src_buf_test, src_buf_size)) < 0 ||
+      (ret = u8_buf_12bit_encoded_to_u16_scalar(src_buf_test, src_buf_size,
+                                                dst_buf, dst_buf_size)) < 0) {
+    goto error;
+  }
+  cl_stats_reset(test_stats);
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_stats(
+           src_buf_test_lut, src_buf_size, test_stats)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time log stats: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value normal: %u, Value log stats: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+  if (check_stats(test_stats, dst_buf, dst_buf_size, "log") < 0)
+    goto error;
+
+  printf("\nu8_buf_log_encoded_12bit_to_u16\n");
+
+  // log encoded input for the inverse kernels (src_buf is not needed anymore)
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(
+           src_buf, src_buf_size)) < 0) {
+    goto error;
+  }
+
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_u16_scalar(
+           src_buf, src_buf_size, dst_buf, dst_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode normal: %ldns\n", elapsed_lut);
+
+#ifdef __SSE4_1__
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_u16_sse4(
+           src_buf, src_buf_size, dst_buf_sse, dst_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode SSE4: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < dst_buf_size; ++i) {
+    if (dst_buf[i] != dst_buf_sse[i]) {
+      printf("Index: %lu, Value normal: %u, Value decode SSE4: %u\n", i,
+             dst_buf[i], dst_buf_sse[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __AVX2__
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_u16_avx2(
+           src_buf, src_buf_size, dst_buf_avx, dst_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode AVX2: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < dst_buf_size; ++i) {
+    if (dst_buf[i] != dst_buf_avx[i]) {
+      printf("Index: %lu, Value normal: %u, Value decode AVX2: %u\n", i,
+             dst_buf[i], dst_buf_avx[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __aarch64__
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_u16_neon(
+           src_buf, src_buf_size, dst_buf_neon, dst_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode NEON: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < dst_buf_size; ++i) {
+    if (dst_buf[i] != dst_buf_neon[i]) {
+      printf("Index: %lu, Value normal: %u, Value decode NEON: %u\n", i,
+             dst_buf[i], dst_buf_neon[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+  // the encoder input has 12 significant bits, so the decoded values must
+  // fit into 12 bits and encode back to the very same log values
+  for (size_t i = 0; i < dst_buf_size; ++i) {
+    if ((dst_buf[i] & 0x0F) != 0) {
+      printf("Index: %lu, Value decode normal: %u, not 12 bit\n", i,
+             dst_buf[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+    dst_buf[i] >>= 4;
+  }
+  if ((ret = u16_buf_to_u8_12bit_encoded_scalar(dst_buf, dst_buf_size,
+                                                src_buf_test, src_buf_size)) <
+      0) {
+    goto error;
+  }
+  memcpy(src_buf_test_lut, src_buf_test, src_buf_size);
+  if ((ret = u8_buf_12bit_encoded_to_log_encoded_12bit_scalar(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value log: %u, Value round trip: %u\n", i,
+             src_buf[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+
+  printf("\nu8_buf_log_encoded_12bit_to_linear_12bit\n");
+
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_linear_12bit_scalar(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode in-place normal: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value in-place normal: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+
+#ifdef __SSE4_1__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_linear_12bit_sse4(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode in-place SSE4: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value in-place SSE4: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __AVX2__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_linear_12bit_avx2(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode in-place AVX2: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value in-place AVX2: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
+#ifdef __aarch64__
+  memcpy(src_buf_test_lut, src_buf, src_buf_size);
+  restart_high_resolution_timer(&timer);
+  if ((ret = u8_buf_log_encoded_12bit_to_linear_12bit_neon(
+           src_buf_test_lut, src_buf_size)) < 0) {
+    goto error;
+  }
+  elapsed_lut = elapsed_high_resolution_time_nanoseconds(&timer);
+  printf("Elapsed time decode in-place NEON: %ldns\n", elapsed_lut);
+
+  for (size_t i = 0; i < src_buf_size; ++i) {
+    if (src_buf_test[i] != src_buf_test_lut[i]) {
+      printf("Index: %lu, Value reference: %u, Value in-place NEON: %u\n", i,
+             src_buf_test[i], src_buf_test_lut[i]);
+      if (error_counter++ > 20)
+        goto error;
+    }
+  }
+#endif
+
   printf("\n\n");
   free(src_buf);
   free(src_buf_test);
+  free(src_buf_test_lut);
   free(dst_buf);
 #ifdef __aarch64__
   free(src_buf_test_neon);
@@ -347,6 +1261,7 @@ int run_test(const size_t buf_size, size_t src_alloc_size,
 error:
   free(src_buf);
   free(src_buf_test);
+  free(src_buf_test_lut);
   free(dst_buf);
 #ifdef __aarch64__
   free(src_buf_test_neon);
@@ -366,8 +1281,139 @@ error:
   return -1;
 }
 
+int test_curves() {
+  int ret;
+  uint16_t table[4096];
+
+  printf("cl_curve\n");
+  for (size_t i = 0; i < 4096; ++i)
+    table[i] = 4096;
+  if ((ret = cl_curve_from_table(&test_curve, table, 4095)) !=
+          CL_ERR_CURVE_SIZE ||
+      (ret = cl_curve_from_table(&test_curve, table, 4096)) !=
+          CL_ERR_CURVE_RANGE) {
+    goto error;
+  }
+
+  cl_curve_t *curve;
+  const cl_curve_params_t nan_params[] = {
+      {CL_CURVE_GAMMA, 256, NAN, 2.4},
+      {CL_CURVE_GAMMA, 256, 4.5, NAN},
+      {CL_CURVE_LOG, 64, NAN, 0.0},
+  };
+  for (size_t i = 0; i < sizeof(nan_params) / sizeof(cl_curve_params_t);
+       ++i) {
+    if ((ret = cl_curve_from_params(&curve, &nan_params[i])) !=
+        CL_ERR_CURVE_PARAMS) {
+      printf("Curve: %lu, NaN parameter accepted\n", i);
+      if (ret >= 0)
+        cl_curve_free(curve);
+      goto error;
+    }
+  }
+
+  const cl_curve_params_t curve_params[] = {
+      {CL_CURVE_GAMMA, 0, 0.0, 2.2},
+      {CL_CURVE_GAMMA, 256, 4.5, 2.4},
+      {CL_CURVE_LOG, 64, 16.0, 0.0},
+  };
+  for (size_t i = 0; i < sizeof(curve_params) / sizeof(cl_curve_params_t);
+       ++i) {
+    if ((ret = cl_curve_from_params(&curve, &curve_params[i])) < 0)
+      goto error;
+    const uint16_t *curve_table = cl_curve_table(curve);
+    // every parametric curve is monotonic and spans the full 12 bit range
+    for (size_t v = 1; v < 4096; ++v) {
+      if (curve_table[v] < curve_table[v - 1]) {
+        printf("Curve: %lu, Index: %lu, not monotonic\n", i, v);
+        cl_curve_free(curve);
+        goto error;
+      }
+    }
+    if (curve_table[0] != 0 || curve_table[4095] != 4095) {
+      printf("Curve: %lu, Range: [%u, %u]\n", i, curve_table[0],
+             curve_table[4095]);
+      cl_curve_free(curve);
+      goto error;
+    }
+    cl_curve_free(curve);
+  }
+
+  // the conversion tests run a random table to catch every lane mix-up
+  for (size_t i = 0; i < 4096; ++i)
+    table[i] = rand() & 0x0FFF;
+  if ((ret = cl_curve_from_table(&test_curve, table, 4096)) < 0)
+    goto error;
+  printf("Success\n\n");
+  return 0;
+error:
+  fprintf(stderr, "Something went wrong :(\n");
+  if (ret)
+    fprintf(stderr, "%s\n", cl_error_message_from_return_code(ret));
+  return -1;
+}
+
+int test_op_chains() {
+  int ret;
+  const cl_op_t invalid_ops[] = {
+      {CL_OP_BLACK_LEVEL, {4096, 0}, {0.0, 0.0}, NULL},
+      {CL_OP_GAIN, {0, 0}, {1.0, 16.0}, NULL},
+      {CL_OP_GAIN, {0, 0}, {-1.0, 1.0}, NULL},
+      {CL_OP_CURVE, {0, 0}, {0.0, 0.0}, NULL},
+      {-1, {0, 0}, {0.0, 0.0}, NULL},
+  };
+
+  printf("cl_op_chain\n");
+  for (size_t i = 0; i < sizeof(invalid_ops) / sizeof(cl_op_t); ++i) {
+    if ((ret = cl_op_chain_create(&test_op_chain, &invalid_ops[i], 1)) !=
+        CL_ERR_OP_CHAIN) {
+      printf("Op: %lu, not rejected\n", i);
+      goto error;
+    }
+  }
+  if ((ret = cl_op_chain_create(&test_op_chain, test_ops,
+                                CL_OP_CHAIN_MAX + 1)) != CL_ERR_OP_CHAIN) {
+    goto error;
+  }
+
+  test_ops[3].curve = test_curve;
+  if ((ret = cl_op_chain_create(&test_op_chain, test_ops,
+                                sizeof(test_ops) / sizeof(cl_op_t))) < 0)
+    goto error;
+  printf("Success\n\n");
+  return 0;
+error:
+  fprintf(stderr, "Something went wrong :(\n");
+  if (ret)
+    fprintf(stderr, "%s\n", cl_error_message_from_return_code(ret));
+  return -1;
+}
+
+int test_crc32c() {
+  // the check value of the CRC-32C catalogue entry
+  const char check[] = "123456789";
+  printf("cl_crc32c\n");
+  if (cl_crc32c_scalar(0, check, 9) != 0xE3069283 ||
+      cl_crc32c(0, check, 9) != 0xE3069283 ||
+      cl_crc32c(cl_crc32c(0, check, 4), &check[4], 5) != 0xE3069283 ||
+      cl_crc32c_combine(cl_crc32c(0, check, 4), cl_crc32c(0, &check[4], 5),
+                        5) != 0xE3069283 ||
+      cl_crc32c_combine(0xE3069283, 0, 0) != 0xE3069283) {
+    fprintf(stderr, "Something went wrong :(\n");
+    return -1;
+  }
+  printf("Success\n\n");
+  return 0;
+}
+
 int main() {
   srand(time(NULL));
+  printf("Dispatched kernels: %s\n\n", cl_isa_name(cl_isa()));
+  if (test_curves() < 0 || test_op_chains() < 0 || test_crc32c() < 0 ||
+      cl_stats_create(&test_stats) < 0) {
+    exit(1);
+    return 1;
+  }
   for (size_t buf_size = 0; buf_size < 143; buf_size += 12) {
     if (run_test(buf_size, 256, 128) < 0) {
       exit(1);
@@ -379,6 +1425,9 @@ int main() {
     exit(1);
     return 1;
   }
+  cl_stats_free(test_stats);
+  cl_op_chain_free(test_op_chain);
+  cl_curve_free(test_curve);
   printf("\nSuccess: All Tests passed. :)\n");
   return 0;
 }
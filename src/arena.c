@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+struct arena_block {
+  arena_block_t *next;
+  size_t size;
+  size_t used;
+  _Alignas(max_align_t) char data[];
+};
+
+void arena_init(arena_t *a) {
+  a->__block = NULL;
+  a->__str_len = 0;
+}
+
+// a new block takes over the string under construction
+static int arena_grow(arena_t *a, const size_t min_size) {
+  size_t size = ARENA_BLOCK_SIZE;
+  while (size < min_size)
+    size <<= 1;
+  arena_block_t *block =
+      (arena_block_t *)malloc(sizeof(arena_block_t) + size);
+  if (block == NULL)
+    return -1;
+  block->size = size;
+  block->used = 0;
+  if (a->__str_len)
+    memcpy(block->data, &a->__block->data[a->__block->used], a->__str_len);
+  block->next = a->__block;
+  a->__block = block;
+  return 0;
+}
+
+void *arena_alloc(arena_t *a, const size_t size) {
+  const size_t aligned_size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (a->__block == NULL ||
+      a->__block->size - a->__block->used < aligned_size) {
+    if (arena_grow(a, aligned_size) != 0)
+      return NULL;
+  }
+  void *ptr = &a->__block->data[a->__block->used];
+  a->__block->used += aligned_size;
+  return ptr;
+}
+
+int arena_str_append(arena_t *a, const char *data, const size_t n) {
+  // + 1 for the terminating 0
+  const size_t str_size = a->__str_len + n + 1;
+  if (a->__block == NULL || a->__block->size - a->__block->used < str_size) {
+    if (arena_grow(a, str_size) != 0)
+      return -1;
+  }
+  memcpy(&a->__block->data[a->__block->used + a->__str_len], data, n);
+  a->__str_len += n;
+  return 0;
+}
+
+const char *arena_str_finish(arena_t *a) {
+  if (arena_str_append(a, "", 0) != 0)
+    return NULL;
+  char *str = &a->__block->data[a->__block->used];
+  str[a->__str_len] = 0;
+  // keeps the blocks aligned for arena_alloc, the block sizes are multiples
+  // of ARENA_ALIGN, so the rounded up string still fits
+  a->__block->used +=
+      (a->__str_len + 1 + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  a->__str_len = 0;
+  return str;
+}
+
+size_t arena_str_len(const arena_t *a) { return a->__str_len; }
+
+void arena_free(arena_t *a) {
+  arena_block_t *block = a->__block;
+  while (block != NULL) {
+    arena_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena_init(a);
+}
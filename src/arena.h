@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct arena_block arena_block_t;
+
+/**
+ * bump allocator for objects living until the end of the program
+ * (file paths, tasks), everything is released at once by arena_free
+ * IMPORTANT: NOT thread safe
+ **/
+typedef struct arena {
+  arena_block_t *__block;
+  size_t __str_len; // of the string under construction
+} arena_t;
+
+void arena_init(arena_t *a);
+
+/**
+ * IMPORTANT: the memory is aligned to max_align_t
+ * IMPORTANT: NOT allowed while a string is under construction
+ **/
+void *arena_alloc(arena_t *a, size_t size);
+
+/**
+ * appends n bytes to the string under construction,
+ * so strings of any length can be built from partial reads
+ **/
+int arena_str_append(arena_t *a, const char *data, size_t n);
+
+/**
+ * terminates and returns the string under construction
+ **/
+const char *arena_str_finish(arena_t *a);
+
+size_t arena_str_len(const arena_t *a);
+
+void arena_free(arena_t *a);
+
+#endif
@@ -1,6 +1,7 @@
 #!/bin/python3
 
 from os import system
+from os.path import getsize
 from time import time_ns
 from argparse import ArgumentParser
 from functools import reduce
@@ -10,6 +11,18 @@ def mean(iter):
     return reduce(lambda a, b: a + b, iter) / len(iter)
 
 
+def run(exec_str, iterations):
+    start = []
+    stop = []
+
+    for i in range(0, iterations):
+        start.append(time_ns())
+        system(exec_str)
+        stop.append(time_ns())
+
+    return mean(stop) - mean(start)
+
+
 def main():
     arg_parser = ArgumentParser()
     arg_parser.add_argument('-f', '--file', type=str, required=True)
@@ -17,6 +30,15 @@ def main():
     arg_parser.add_argument('-i', '--iterations', type=int, default=1)
     arg_parser.add_argument('-t', '--threads', type=int, default=1)
     arg_parser.add_argument('-v', '--verbose', type=bool, default=False)
+    # converts out-of-place, so every iteration converts the original data
+    arg_parser.add_argument('-o', '--output-dir', type=str, default=None)
+    # runs with and without huge pages and reports the difference
+    arg_parser.add_argument('-H', '--huge-pages', action='store_true')
+    # runs every durability policy and reports their throughput
+    arg_parser.add_argument('-D', '--durability', action='store_true')
+    # runs with the given small file threshold (MiB) and with mapping every
+    # file, use a file below the threshold
+    arg_parser.add_argument('-S', '--small-file', type=int, default=None)
 
     args = arg_parser.parse_args()
 
@@ -32,22 +54,46 @@ def main():
         system(f'cp {args.file} {cp_file}')
         all_files.append(cp_file)
 
-    exec_str = './raw_converter ' + \
+    # every iteration converts the same files again, which would otherwise be
+    # skipped as already converted
+    exec_str = './raw_converter -f' + \
         f' -t {args.threads}' + \
-        (' -v' if args.verbose else '') + ' ' + ' '.join(all_files)
-
-    start = []
-    stop = []
-
-    for i in range(0, args.iterations):
-        start.append(time_ns())
-        system(exec_str)
-        stop.append(time_ns())
+        (' -v' if args.verbose else '') + \
+        (f' -o {args.output_dir}' if args.output_dir else '') + \
+        ' ' + ' '.join(all_files)
+
+    total_bytes = getsize(args.file) * args.number
+
+    time = run(exec_str, args.iterations)
+    print(f'Time: {time}ns')
+    print(f'Throughput: {total_bytes / time * 1e3:.1f}MB/s')
+
+    if args.huge_pages:
+        time_huge = run(exec_str.replace(' -t', ' -H -t', 1), args.iterations)
+        print(f'Time (huge pages): {time_huge}ns')
+        print('Throughput (huge pages): '
+              f'{total_bytes / time_huge * 1e3:.1f}MB/s')
+        print(f'Throughput difference: {(time / time_huge - 1) * 100:+.1f}%')
+
+    if args.durability:
+        for mode in ['per-file', 'batch', 'none']:
+            time_mode = run(exec_str.replace(' -t', f' -d {mode} -t', 1),
+                            args.iterations)
+            print(f'Time (durability {mode}): {time_mode}ns')
+            print(f'Throughput (durability {mode}): '
+                  f'{total_bytes / time_mode * 1e3:.1f}MB/s')
+
+    if args.small_file is not None:
+        for threshold in [0, args.small_file]:
+            time_threshold = run(
+                exec_str.replace(' -t', f' -S {threshold} -t', 1),
+                args.iterations)
+            print(f'Time (small file {threshold}MiB): {time_threshold}ns')
+            print(f'Throughput (small file {threshold}MiB): '
+                  f'{total_bytes / time_threshold * 1e3:.1f}MB/s')
 
     system(f'rm {" ".join(all_files)}')
 
-    print(f'Time: {mean(stop) - mean(start)}ns')
-
 
 if __name__ == '__main__':
     main()
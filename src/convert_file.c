@@ -16,13 +16,22 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE // O_DIRECT
+
 #include "convert_file.h"
+#include "trace.h"
+#include "uring.h"
+#include <pthread.h>
 
 static const char *const error_messages[] = {
     "Success.", // 0
     ("System Error occured while converting the file. Check errno for further "
-     "information."),                    // (-)1
-    "Filesize does not fit the format.", // (-)2
+     "information."),                     // (-)1
+    "Filesize does not fit the format.",  // (-)2
+    "The output file is the input file.", // (-)3
+    "The file is already converted.",     // (-)4
+    "The checksum does not match.",       // (-)5
+    "The file carries no checksum.",      // (-)6
 };
 
 #define ABS(val) (((val) >= 0) ? (val) : (-(val)))
@@ -36,12 +45,933 @@ const char *c_error_message_from_return_code(int return_code) {
   return error_messages[index];
 }
 
-#define FILE_HEADER_SIZE 512
+#define STATS_FILE_SUFFIX ".stats"
+
+int convert_file_write_stats(const char *file_path, const cl_stats_t *stats) {
+  int return_code = C_SUCCESS;
+  cl_channel_stats_t channel_stats[2];
+  cl_stats_channel(stats, CL_CHANNEL_G, &channel_stats[CL_CHANNEL_G]);
+  cl_stats_channel(stats, CL_CHANNEL_R, &channel_stats[CL_CHANNEL_R]);
+
+  const size_t path_len = strlen(file_path);
+  char *stats_path = (char *)malloc(path_len + sizeof(STATS_FILE_SUFFIX));
+  if (stats_path == NULL)
+    return C_ERR_SYS;
+  memcpy(stats_path, file_path, path_len);
+  memcpy(&stats_path[path_len], STATS_FILE_SUFFIX, sizeof(STATS_FILE_SUFFIX));
+
+  FILE *file = fopen(stats_path, "w");
+  if (file == NULL) {
+    return_code = C_ERR_SYS;
+    goto err;
+  }
+  fprintf(file, "channel count min max mean\n");
+  for (int ch = CL_CHANNEL_G; ch <= CL_CHANNEL_R; ++ch) {
+    fprintf(file, "%c %" PRIu64 " %u %u %.3f\n",
+            (ch == CL_CHANNEL_G) ? 'G' : 'R', channel_stats[ch].count,
+            channel_stats[ch].min, channel_stats[ch].max,
+            channel_stats[ch].mean);
+  }
+  fprintf(file, "bin G R\n");
+  for (size_t v = 0; v < 4096; ++v) {
+    fprintf(file, "%zu %" PRIu64 " %" PRIu64 "\n", v,
+            channel_stats[CL_CHANNEL_G].hist[v],
+            channel_stats[CL_CHANNEL_R].hist[v]);
+  }
+  if (ferror(file))
+    return_code = C_ERR_SYS;
+  if (fclose(file) != 0)
+    return_code = C_ERR_SYS;
+
+err:
+  free(stats_path);
+  return return_code;
+}
+
+static int io_backend = C_IO_MMAP;
+static size_t mmap_window = 0;
+static size_t pread_threshold = 0;
+static bool huge_pages = false;
+static int durability = C_DURABILITY_FILE;
+
+// the buffers of the io_uring backend, the pread path and the pipe mode
+static void *alloc_buf(const size_t alignment, const size_t size) {
+  if (huge_pages)
+    return cl_alloc_huge(size);
+  return aligned_alloc(alignment, size);
+}
+
+// the clock is only read if the phases are timed
+static uint64_t metrics_now(const c_metrics_t *metrics) {
+  if (metrics == NULL)
+    return 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static const char *const phase_names[C_PHASES] = {"open", "map", "convert",
+                                                  "sync"};
+
+const char *c_phase_name(const int phase) {
+  if (phase < 0 || phase >= C_PHASES)
+    return NULL;
+  return phase_names[phase];
+}
+
+// every timed phase is a span of the trace as well
+static void metrics_add(c_metrics_t *metrics, const int phase,
+                        const uint64_t start) {
+  if (metrics == NULL)
+    return;
+  const uint64_t end = metrics_now(metrics);
+  metrics->phase_ns[phase] += end - start;
+  trace_span(phase_names[phase], NULL, start, end);
+}
+
+// the pixel data is copied and converted in blocks fitting the L2 cache,
+// a multiple of 96 keeps the blocks aligned to 32 bytes
+#define COPY_BLOCK_SIZE (96 * 2048)
+
+// reads exactly size bytes, a file truncated concurrently is an EIO
+static int pread_full(const int fd, uint8_t *buf, size_t size, off_t offset) {
+  while (size) {
+    const ssize_t n = pread(fd, buf, size, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return C_ERR_SYS;
+    }
+    if (n == 0) {
+      errno = EIO;
+      return C_ERR_SYS;
+    }
+    buf += n;
+    size -= n;
+    offset += n;
+  }
+  return C_SUCCESS;
+}
+
+static int pwrite_full(const int fd, const uint8_t *buf, size_t size,
+                       off_t offset) {
+  while (size) {
+    const ssize_t n = pwrite(fd, buf, size, offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return C_ERR_SYS;
+    }
+    buf += n;
+    size -= n;
+    offset += n;
+  }
+  return C_SUCCESS;
+}
+
+// if crc is NOT NULL it is continued with the converted pixels, which are
+// checksummed while the kernel still holds them in the registers
+static int convert_buf(uint8_t *buf, const size_t size, cl_stats_t *stats,
+                       uint32_t *crc, c_metrics_t *metrics) {
+  const uint64_t start = metrics_now(metrics);
+  int return_code;
+  if (crc != NULL)
+    return_code = u8_buf_12bit_encoded_to_log_encoded_12bit_crc32c(
+        buf, size, stats, crc);
+  else if (stats != NULL)
+    return_code =
+        u8_buf_12bit_encoded_to_log_encoded_12bit_stats(buf, size, stats);
+  else
+    return_code = u8_buf_12bit_encoded_to_log_encoded_12bit(buf, size);
+  metrics_add(metrics, C_PHASE_CONVERT, start);
+  return return_code;
+}
+
+// maps only the pages holding [offset, offset + size) of the destination,
+// so chunks of the same file can be converted concurrently.
+// out-of-place the source is read into the mapping block by block and
+// every block is converted while it is still cached
+static int convert_window_mmap(const int src_fd, const int dst_fd,
+                               const size_t offset, const size_t size,
+                               cl_stats_t *stats, uint32_t *crc,
+                               const bool sync, c_metrics_t *metrics) {
+  int return_code = C_SUCCESS;
+  uint64_t start = metrics_now(metrics);
+
+  const size_t map_offset = offset & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+  const size_t map_size = offset - map_offset + size;
+#ifdef __linux__
+  // with huge pages the mapping is populated after the advice,
+  // so the faults can already map huge pages
+  const int mmap_flags = huge_pages ? MAP_SHARED : MAP_SHARED | MAP_POPULATE;
+#else
+  const int mmap_flags = MAP_SHARED;
+#endif
+  uint8_t *file_map = (uint8_t *)mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                      mmap_flags, dst_fd, map_offset);
+  if (file_map == MAP_FAILED)
+    return C_ERR_SYS;
+
+#ifdef __linux__
+  if (huge_pages) {
+    // only advice, most file systems (other than tmpfs) do NOT support
+    // huge pages in writable file mappings
+    madvise(file_map, map_size, MADV_HUGEPAGE);
+#ifdef MADV_POPULATE_WRITE
+    madvise(file_map, map_size, MADV_POPULATE_WRITE); // since Linux 5.14
+#endif
+  }
+#endif
+
+  if (madvise(file_map, map_size, MADV_SEQUENTIAL | MADV_WILLNEED) < 0) {
+    return_code = C_ERR_SYS;
+    goto err_map;
+  }
+
+  metrics_add(metrics, C_PHASE_MAP, start);
+
+  uint8_t *buf = &file_map[offset - map_offset];
+  if (src_fd == dst_fd) {
+    return_code = convert_buf(buf, size, stats, crc, metrics);
+  } else {
+    for (size_t done = 0; done < size && return_code == C_SUCCESS;
+         done += COPY_BLOCK_SIZE) {
+      const size_t block_size =
+          (size - done > COPY_BLOCK_SIZE) ? COPY_BLOCK_SIZE : size - done;
+      start = metrics_now(metrics);
+      return_code = pread_full(src_fd, &buf[done], block_size, offset + done);
+      metrics_add(metrics, C_PHASE_MAP, start);
+      if (return_code == C_SUCCESS)
+        return_code =
+            convert_buf(&buf[done], block_size, stats, crc, metrics);
+    }
+  }
+  if (return_code < 0)
+    goto err_map;
+
+  start = metrics_now(metrics);
+  if (sync && msync(file_map, map_size, MS_SYNC) < 0) {
+    return_code = C_ERR_SYS;
+  }
+  metrics_add(metrics, C_PHASE_SYNC, start);
+
+err_map:
+  start = metrics_now(metrics);
+  if (munmap(file_map, map_size) < 0) {
+    return_code = C_ERR_SYS;
+  }
+  metrics_add(metrics, C_PHASE_MAP, start);
+  return return_code;
+}
+
+// starts writing back a finished range without waiting for the device,
+// elsewhere the page cache writes it back on its own
+static int start_writeback(const int fd, const size_t offset,
+                           const size_t size) {
+#ifdef __linux__
+  if (sync_file_range(fd, offset, size, SYNC_FILE_RANGE_WRITE) < 0)
+    return C_ERR_SYS;
+#else
+  (void)fd;
+  (void)offset;
+  (void)size;
+#endif
+  return C_SUCCESS;
+}
+
+// with a window only mmap_window bytes of the range are mapped at a time,
+// so the conversion starts after populating the first window and the RSS
+// stays bounded. the next window is read ahead while the current one is
+// converted and the writeback of every finished window starts right away
+static int convert_range_mmap(const int src_fd, const int dst_fd,
+                              const size_t offset, const size_t size,
+                              cl_stats_t *stats, uint32_t *crc,
+                              c_metrics_t *metrics) {
+  int return_code = C_SUCCESS;
+  uint64_t start;
+  if (!mmap_window || size <= mmap_window) {
+    return_code = convert_window_mmap(src_fd, dst_fd, offset, size, stats, crc,
+                                      durability == C_DURABILITY_FILE, metrics);
+    start = metrics_now(metrics);
+    if (return_code == C_SUCCESS && durability == C_DURABILITY_BATCH)
+      return_code = start_writeback(dst_fd, offset, size);
+    metrics_add(metrics, C_PHASE_SYNC, start);
+    return return_code;
+  }
+
+  for (size_t done = 0; done < size && return_code == C_SUCCESS;
+       done += mmap_window) {
+    const size_t window_size =
+        (size - done > mmap_window) ? mmap_window : size - done;
+#ifdef __linux__
+    if (done + window_size < size)
+      posix_fadvise(src_fd, offset + done + window_size, mmap_window,
+                    POSIX_FADV_WILLNEED);
+#endif
+    return_code = convert_window_mmap(src_fd, dst_fd, offset + done,
+                                      window_size, stats, crc, false, metrics);
+    start = metrics_now(metrics);
+    if (return_code == C_SUCCESS && durability != C_DURABILITY_NONE)
+      return_code = start_writeback(dst_fd, offset + done, window_size);
+    metrics_add(metrics, C_PHASE_SYNC, start);
+  }
+  // the equivalent of msync(MS_SYNC) over the unmapped windows
+  start = metrics_now(metrics);
+  if (return_code == C_SUCCESS && durability == C_DURABILITY_FILE &&
+      fdatasync(dst_fd) < 0)
+    return_code = C_ERR_SYS;
+  metrics_add(metrics, C_PHASE_SYNC, start);
+  return return_code;
+}
+
+// page aligned, so the buffer fits every kernel and whole pages are copied
+#define PREAD_BUF_ALIGN 4096
+
+typedef struct pread_buf {
+  uint8_t *buf;
+  size_t size;
+} pread_buf_t;
+
+static pthread_key_t pread_buf_key;
+static pthread_once_t pread_buf_key_once = PTHREAD_ONCE_INIT;
+
+static void pread_buf_free(void *ptr) {
+  pread_buf_t *pbuf = (pread_buf_t *)ptr;
+  free(pbuf->buf);
+  free(pbuf);
+}
+
+static void pread_buf_key_create(void) {
+  pthread_key_create(&pread_buf_key, pread_buf_free);
+}
+
+// every worker thread reuses its buffer, it only grows up to pread_threshold
+static uint8_t *pread_buf_get(const size_t size) {
+  pthread_once(&pread_buf_key_once, pread_buf_key_create);
+  pread_buf_t *pbuf = (pread_buf_t *)pthread_getspecific(pread_buf_key);
+  if (pbuf == NULL) {
+    pbuf = (pread_buf_t *)calloc(1, sizeof(pread_buf_t));
+    if (pbuf == NULL)
+      return NULL;
+    const int err = pthread_setspecific(pread_buf_key, pbuf);
+    if (err) {
+      free(pbuf);
+      errno = err;
+      return NULL;
+    }
+  }
+  if (pbuf->size < size) {
+    const size_t buf_size =
+        (size + PREAD_BUF_ALIGN - 1) & ~(size_t)(PREAD_BUF_ALIGN - 1);
+    uint8_t *buf = (uint8_t *)alloc_buf(PREAD_BUF_ALIGN, buf_size);
+    if (buf == NULL)
+      return NULL;
+    free(pbuf->buf);
+    pbuf->buf = buf;
+    pbuf->size = buf_size;
+  }
+  return pbuf->buf;
+}
+
+// for a few MB the mapping costs more than the conversion (page tables,
+// faults, munmap and its TLB shootdown), two copies through a reused buffer
+// are cheaper
+static int convert_range_pread(const int src_fd, const int dst_fd,
+                               const size_t offset, const size_t size,
+                               cl_stats_t *stats, uint32_t *crc,
+                               c_metrics_t *metrics) {
+  uint8_t *buf = pread_buf_get(size);
+  if (buf == NULL)
+    return C_ERR_SYS;
+  uint64_t start = metrics_now(metrics);
+  int return_code = pread_full(src_fd, buf, size, offset);
+  metrics_add(metrics, C_PHASE_MAP, start);
+  if (return_code == C_SUCCESS)
+    return_code = convert_buf(buf, size, stats, crc, metrics);
+  start = metrics_now(metrics);
+  if (return_code == C_SUCCESS)
+    return_code = pwrite_full(dst_fd, buf, size, offset);
+  metrics_add(metrics, C_PHASE_MAP, start);
+  if (return_code != C_SUCCESS)
+    return return_code;
+  start = metrics_now(metrics);
+  if (durability == C_DURABILITY_FILE && fdatasync(dst_fd) < 0)
+    return_code = C_ERR_SYS;
+  else if (durability == C_DURABILITY_BATCH)
+    return_code = start_writeback(dst_fd, offset, size);
+  metrics_add(metrics, C_PHASE_SYNC, start);
+  return return_code;
+}
+
+#ifdef __linux__
+// O_DIRECT needs offsets, sizes and buffers aligned to the logical block size
+#define DIRECT_IO_ALIGN 4096
+// every slot holds one piece of the range in flight,
+// a multiple of the pixel group (12 bytes) and of DIRECT_IO_ALIGN
+#define URING_SLOT_SIZE (DIRECT_IO_ALIGN * 3 * 64)
+#define URING_SLOTS 4
+
+#define SLOT_FREE 0
+#define SLOT_READING 1
+#define SLOT_WRITING 2
+
+typedef struct uring_slot {
+  uint8_t *buf;
+  size_t offset; // in the file
+  size_t size;
+  size_t done; // bytes of the current read or write
+  uint32_t crc; // of the converted piece
+  int read_fd;
+  int write_fd;
+  int state;
+} uring_slot_t;
+
+// every worker thread owns a ring and its registered buffers
+typedef struct uring_ctx {
+  uring_t ring;
+  uint8_t *bufs;
+  bool fixed_bufs;
+} uring_ctx_t;
+
+static pthread_key_t uring_ctx_key;
+static pthread_once_t uring_ctx_key_once = PTHREAD_ONCE_INIT;
+
+static void uring_ctx_free(void *ptr) {
+  uring_ctx_t *ctx = (uring_ctx_t *)ptr;
+  uring_free(&ctx->ring);
+  free(ctx->bufs);
+  free(ctx);
+}
+
+static void uring_ctx_key_create(void) {
+  pthread_key_create(&uring_ctx_key, uring_ctx_free);
+}
+
+static uring_ctx_t *uring_ctx_get(void) {
+  uring_ctx_t *ctx = (uring_ctx_t *)pthread_getspecific(uring_ctx_key);
+  if (ctx != NULL)
+    return ctx;
+  ctx = (uring_ctx_t *)malloc(sizeof(uring_ctx_t));
+  if (ctx == NULL)
+    return NULL;
+  ctx->bufs =
+      (uint8_t *)alloc_buf(DIRECT_IO_ALIGN, URING_SLOTS * URING_SLOT_SIZE);
+  if (ctx->bufs == NULL)
+    goto err_ctx;
+  if (uring_init(&ctx->ring, URING_SLOTS * 2) < 0)
+    goto err_bufs;
+  struct iovec iovs[URING_SLOTS];
+  for (int i = 0; i < URING_SLOTS; ++i) {
+    iovs[i].iov_base = &ctx->bufs[i * URING_SLOT_SIZE];
+    iovs[i].iov_len = URING_SLOT_SIZE;
+  }
+  // the registration is charged against RLIMIT_MEMLOCK on older kernels,
+  // without it the buffers are mapped on every request instead
+  ctx->fixed_bufs = uring_register_buffers(&ctx->ring, iovs, URING_SLOTS) == 0;
+  if (pthread_setspecific(uring_ctx_key, ctx) != 0) {
+    uring_free(&ctx->ring);
+    goto err_bufs;
+  }
+  return ctx;
+
+err_bufs:
+  free(ctx->bufs);
+err_ctx:
+  free(ctx);
+  return NULL;
+}
+
+// the smallest position >= pos which is block aligned for O_DIRECT
+// and the start of a pixel group
+static size_t next_direct_boundary(const size_t pos) {
+  size_t boundary =
+      (pos + DIRECT_IO_ALIGN - 1) & ~(size_t)(DIRECT_IO_ALIGN - 1);
+  while ((boundary - FILE_HEADER_SIZE) % 12)
+    boundary += DIRECT_IO_ALIGN;
+  return boundary;
+}
+
+// the source and the destination of a range, the same file in-place
+typedef struct uring_files {
+  int src_fd;
+  int dst_fd;
+  int src_direct_fd; // -1 if the file system does NOT support O_DIRECT
+  int dst_direct_fd;
+} uring_files_t;
+
+// the block aligned interior of the range bypasses the page cache,
+// the unaligned head and tail (shared with neighbouring chunks) do NOT
+static void uring_slot_plan(uring_slot_t *slot, const size_t pos,
+                            const size_t end, const uring_files_t *files) {
+  slot->offset = pos;
+  slot->done = 0;
+  slot->state = SLOT_READING;
+  slot->read_fd = files->src_fd;
+  slot->write_fd = files->dst_fd;
+  if (files->src_direct_fd < 0 || files->dst_direct_fd < 0) {
+    slot->size = (end - pos > URING_SLOT_SIZE) ? URING_SLOT_SIZE : end - pos;
+    return;
+  }
+  const size_t boundary = next_direct_boundary(pos);
+  const size_t direct_size = (end - pos) / (DIRECT_IO_ALIGN * 3) *
+                             (DIRECT_IO_ALIGN * 3);
+  if (boundary != pos) {
+    slot->size = ((boundary < end) ? boundary : end) - pos;
+  } else if (direct_size == 0) {
+    slot->size = end - pos;
+  } else {
+    slot->read_fd = files->src_direct_fd;
+    slot->write_fd = files->dst_direct_fd;
+    slot->size =
+        (direct_size > URING_SLOT_SIZE) ? URING_SLOT_SIZE : direct_size;
+  }
+}
+
+static void uring_slot_submit(uring_ctx_t *ctx, const uring_slot_t *slot,
+                              const int i) {
+  // every slot has at most one request in flight, so the ring never fills up
+  struct io_uring_sqe *sqe = uring_get_sqe(&ctx->ring);
+  const bool read = slot->state == SLOT_READING;
+  if (ctx->fixed_bufs) {
+    sqe->opcode = read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+    sqe->buf_index = i;
+  } else {
+    sqe->opcode = read ? IORING_OP_READ : IORING_OP_WRITE;
+  }
+  sqe->fd = read ? slot->read_fd : slot->write_fd;
+  sqe->off = slot->offset + slot->done;
+  sqe->addr = (uint64_t)(uintptr_t)&slot->buf[slot->done];
+  sqe->len = slot->size - slot->done;
+  sqe->user_data = i;
+}
+
+// keeps URING_SLOTS pieces of the range in flight, so reading, converting
+// and writing back the pieces overlap
+// the pieces complete in any order, the CRC of every piece is shifted over
+// the bytes following it (cl_crc32c_combine) and the shifted CRCs of all
+// pieces add up (xor) to the CRC of the range
+static int convert_range_uring(const char *src_path, const int src_fd,
+                               const char *dst_path, const int dst_fd,
+                               const size_t offset, const size_t size,
+                               cl_stats_t *stats, uint32_t *crc,
+                               c_metrics_t *metrics) {
+  int return_code = C_SUCCESS;
+
+  uring_ctx_t *ctx = uring_ctx_get();
+  if (ctx == NULL)
+    return C_ERR_SYS;
+  // NOT every file system supports O_DIRECT (e.g. tmpfs)
+  const uint64_t open_start = metrics_now(metrics);
+  uring_files_t files = {.src_fd = src_fd, .dst_fd = dst_fd};
+  if (src_fd == dst_fd) {
+    files.src_direct_fd = open(src_path, O_RDWR | O_DIRECT);
+    files.dst_direct_fd = files.src_direct_fd;
+  } else {
+    files.src_direct_fd = open(src_path, O_RDONLY | O_DIRECT);
+    files.dst_direct_fd = open(dst_path, O_WRONLY | O_DIRECT);
+  }
+  metrics_add(metrics, C_PHASE_OPEN, open_start);
+
+  uring_slot_t slots[URING_SLOTS];
+  for (int i = 0; i < URING_SLOTS; ++i) {
+    slots[i].buf = &ctx->bufs[i * URING_SLOT_SIZE];
+    slots[i].state = SLOT_FREE;
+  }
+  const size_t end = offset + size;
+  size_t pos = offset;
+  int in_flight = 0;
+  for (;;) {
+    for (int i = 0;
+         i < URING_SLOTS && pos < end && return_code == C_SUCCESS; ++i) {
+      if (slots[i].state != SLOT_FREE)
+        continue;
+      uring_slot_plan(&slots[i], pos, end, &files);
+      pos += slots[i].size;
+      uring_slot_submit(ctx, &slots[i], i);
+      ++in_flight;
+    }
+    if (!in_flight)
+      break;
+    // waiting for the reads and writes in flight
+    const uint64_t start = metrics_now(metrics);
+    const int submitted = uring_submit_and_wait(&ctx->ring, 1);
+    metrics_add(metrics, C_PHASE_MAP, start);
+    if (submitted < 0) {
+      // the requests in flight may still use the buffers,
+      // so the broken context is leaked instead of freed
+      pthread_setspecific(uring_ctx_key, NULL);
+      return_code = C_ERR_SYS;
+      goto err;
+    }
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek_cqe(&ctx->ring)) != NULL) {
+      const int i = (int)cqe->user_data;
+      const int res = cqe->res;
+      uring_cqe_seen(&ctx->ring);
+      uring_slot_t *slot = &slots[i];
+      if (res <= 0) {
+        if (return_code == C_SUCCESS) {
+          // a read of 0 bytes means the file was truncated
+          errno = (res < 0) ? -res : EIO;
+          return_code = C_ERR_SYS;
+        }
+        slot->state = SLOT_FREE;
+        --in_flight;
+        continue;
+      }
+      slot->done += res;
+      if (slot->done < slot->size && return_code == C_SUCCESS) {
+        uring_slot_submit(ctx, slot, i);
+        continue;
+      }
+      if (slot->state == SLOT_READING && return_code == C_SUCCESS) {
+        slot->crc = 0;
+        const int ret =
+            convert_buf(slot->buf, slot->size, stats,
+                        (crc != NULL) ? &slot->crc : NULL, metrics);
+        if (ret >= 0) {
+          if (crc != NULL)
+            *crc ^= cl_crc32c_combine(slot->crc, 0,
+                                      end - slot->offset - slot->size);
+          slot->done = 0;
+          slot->state = SLOT_WRITING;
+          uring_slot_submit(ctx, slot, i);
+          continue;
+        }
+        return_code = ret;
+      }
+      slot->state = SLOT_FREE;
+      --in_flight;
+    }
+  }
+
+  const uint64_t start = metrics_now(metrics);
+  if (return_code == C_SUCCESS && durability == C_DURABILITY_BATCH)
+    return_code = start_writeback(dst_fd, offset, size);
+  if (return_code == C_SUCCESS && durability == C_DURABILITY_FILE) {
+    // the equivalent of msync(MS_SYNC) on the range, len 0 syncs to the end
+    struct io_uring_sqe *sqe = uring_get_sqe(&ctx->ring);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = dst_fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->off = offset;
+    sqe->len = (size > UINT32_MAX) ? 0 : size;
+    struct io_uring_cqe *cqe;
+    if (uring_submit_and_wait(&ctx->ring, 1) < 0 ||
+        (cqe = uring_peek_cqe(&ctx->ring)) == NULL) {
+      return_code = C_ERR_SYS;
+    } else {
+      if (cqe->res < 0) {
+        errno = -cqe->res;
+        return_code = C_ERR_SYS;
+      }
+      uring_cqe_seen(&ctx->ring);
+    }
+  }
+  metrics_add(metrics, C_PHASE_SYNC, start);
+
+err:
+  if (files.src_direct_fd >= 0 && close(files.src_direct_fd) < 0)
+    return_code = C_ERR_SYS;
+  if (files.dst_direct_fd >= 0 && files.dst_direct_fd != files.src_direct_fd &&
+      close(files.dst_direct_fd) < 0)
+    return_code = C_ERR_SYS;
+  return return_code;
+}
+#endif
+
+int convert_file_set_io(const int io) {
+  if (io == C_IO_URING) {
+#ifdef __linux__
+    // probes the support of the kernel (and seccomp) upfront
+    uring_t ring;
+    if (uring_init(&ring, 1) < 0)
+      return C_ERR_SYS;
+    uring_free(&ring);
+    pthread_once(&uring_ctx_key_once, uring_ctx_key_create);
+#else
+    errno = ENOSYS;
+    return C_ERR_SYS;
+#endif
+  }
+  io_backend = io;
+  return C_SUCCESS;
+}
+
+void convert_file_set_mmap_window(const size_t window) {
+  mmap_window = window / 96 * 96;
+}
+
+void convert_file_set_pread_threshold(const size_t threshold) {
+  pread_threshold = threshold;
+}
+
+void convert_file_set_huge_pages(const bool enable) { huge_pages = enable; }
+
+void convert_file_set_durability(const int mode) { durability = mode; }
+
+int convert_file_sync_fs(const char *path) {
+  int return_code = C_SUCCESS;
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return C_ERR_SYS;
+#ifdef __linux__
+  if (syncfs(fd) < 0)
+    return_code = C_ERR_SYS;
+#else
+  sync();
+#endif
+  if (close(fd) < 0)
+    return_code = C_ERR_SYS;
+  return return_code;
+}
+
+int convert_file_readahead(const char *file_path, const size_t offset,
+                           const size_t size) {
+  // O_DIRECT reads around the page cache, a hint would only read twice
+  if (io_backend == C_IO_URING)
+    return C_SUCCESS;
+  int return_code = C_SUCCESS;
+  const int fd = open(file_path, O_RDONLY);
+  if (fd < 0)
+    return C_ERR_SYS;
+#ifdef __linux__
+  // the first chunk brings the header along, a size of 0 reads up to EOF
+  const off_t start = offset ? FILE_HEADER_SIZE + offset : 0;
+  const off_t len = size ? FILE_HEADER_SIZE + offset + size - start : 0;
+  const int err = posix_fadvise(fd, start, len, POSIX_FADV_WILLNEED);
+  if (err) {
+    errno = err;
+    return_code = C_ERR_SYS;
+  }
+#else
+  (void)offset;
+  (void)size;
+#endif
+  if (close(fd) < 0)
+    return_code = C_ERR_SYS;
+  return return_code;
+}
+
+// writes the CRC32C of the converted range to crc (if NOT NULL)
+static int convert_range(const char *src_path, const int src_fd,
+                         const char *dst_path, const int dst_fd,
+                         const size_t offset, const size_t size,
+                         cl_stats_t *stats, uint32_t *crc,
+                         c_metrics_t *metrics) {
+  if (crc != NULL)
+    *crc = 0;
+#ifdef __linux__
+  if (io_backend == C_IO_URING)
+    return convert_range_uring(src_path, src_fd, dst_path, dst_fd, offset,
+                               size, stats, crc, metrics);
+#else
+  (void)src_path;
+  (void)dst_path;
+#endif
+  if (size <= pread_threshold)
+    return convert_range_pread(src_fd, dst_fd, offset, size, stats, crc,
+                               metrics);
+  return convert_range_mmap(src_fd, dst_fd, offset, size, stats, crc,
+                            metrics);
+}
+
+static int copy_header(const int src_fd, const int dst_fd) {
+#ifdef __linux__
+  // stays in the kernel (or is a reflink), falls back on e.g. EXDEV
+  loff_t src_offset = 0;
+  loff_t dst_offset = 0;
+  if (copy_file_range(src_fd, &src_offset, dst_fd, &dst_offset,
+                      FILE_HEADER_SIZE, 0) == FILE_HEADER_SIZE)
+    return C_SUCCESS;
+#endif
+  uint8_t header[FILE_HEADER_SIZE];
+  int return_code = pread_full(src_fd, header, FILE_HEADER_SIZE, 0);
+  if (return_code == C_SUCCESS)
+    return_code = pwrite_full(dst_fd, header, FILE_HEADER_SIZE, 0);
+  return return_code;
+}
+
+static const uint8_t marker_magic[8] = {'R', 'A', 'W', 'C', 'O', 'N', 'V', 0};
+
+// without a checksum (crc32c is NULL) the marker keeps version 1
+static void fill_marker(uint8_t marker[C_MARKER_SIZE],
+                        const uint32_t *crc32c) {
+  const uint16_t version =
+      (crc32c != NULL) ? C_MARKER_VERSION : C_MARKER_VERSION_NO_CRC;
+  memset(marker, 0, C_MARKER_SIZE);
+  memcpy(marker, marker_magic, sizeof(marker_magic));
+  // little endian, like the pixel data
+  marker[8] = C_CURVE_LOG_ENCODED_12BIT & 0xFF;
+  marker[9] = C_CURVE_LOG_ENCODED_12BIT >> 8;
+  marker[10] = version & 0xFF;
+  marker[11] = version >> 8;
+  if (crc32c != NULL) {
+    for (int i = 0; i < 4; ++i)
+      marker[12 + i] = (*crc32c >> (8 * i)) & 0xFF;
+  }
+}
+
+static int write_marker(const int fd, const uint32_t crc32c) {
+  uint8_t marker[C_MARKER_SIZE];
+  fill_marker(marker, &crc32c);
+  int return_code = pwrite_full(fd, marker, C_MARKER_SIZE, C_MARKER_OFFSET);
+  // the pixel data is already synced, the marker follows it. the copied
+  // header of an out-of-place file is NOT covered by the synced ranges,
+  // this sync of the whole file persists it too
+  if (return_code == C_SUCCESS && durability == C_DURABILITY_FILE &&
+      fdatasync(fd) < 0)
+    return_code = C_ERR_SYS;
+  return return_code;
+}
+
+int convert_file_read_marker(const char *file_path, c_marker_t *marker) {
+  const int fd = open(file_path, O_RDONLY);
+  if (fd < 0)
+    return C_ERR_SYS;
+  uint8_t buf[C_MARKER_SIZE];
+  const ssize_t n = pread(fd, buf, C_MARKER_SIZE, C_MARKER_OFFSET);
+  const int err = errno;
+  close(fd);
+  if (n < 0) {
+    errno = err;
+    return C_ERR_SYS;
+  }
+  // a file without a full header can NOT carry a marker
+  if (n < C_MARKER_SIZE || memcmp(buf, marker_magic, sizeof(marker_magic)))
+    return 0;
+  if (marker != NULL) {
+    marker->curve = buf[8] | (buf[9] << 8);
+    marker->version = buf[10] | (buf[11] << 8);
+    marker->crc32c = 0;
+    if (marker->version >= C_MARKER_VERSION) {
+      for (int i = 0; i < 4; ++i)
+        marker->crc32c |= (uint32_t)buf[12 + i] << (8 * i);
+    }
+  }
+  return 1;
+}
+
+int convert_file_mark(const char *file_path, const uint32_t crc32c,
+                      c_metrics_t *metrics) {
+  const uint64_t start = metrics_now(metrics);
+  const int fd = open(file_path, O_WRONLY);
+  if (fd < 0)
+    return C_ERR_SYS;
+  int return_code = write_marker(fd, crc32c);
+  if (close(fd) < 0)
+    return_code = C_ERR_SYS;
+  metrics_add(metrics, C_PHASE_SYNC, start);
+  return return_code;
+}
+
+int convert_file_verify(const char *file_path, c_metrics_t *metrics) {
+  uint64_t start = metrics_now(metrics);
+  c_marker_t marker;
+  int return_code = convert_file_read_marker(file_path, &marker);
+  if (return_code < 0)
+    return return_code;
+  if (!return_code || marker.version < C_MARKER_VERSION)
+    return C_ERR_NO_CHECKSUM;
+
+  const int fd = open(file_path, O_RDONLY);
+  if (fd < 0)
+    return C_ERR_SYS;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    return_code = C_ERR_SYS;
+    goto err;
+  }
+  if (file_stat.st_size <= FILE_HEADER_SIZE) {
+    return_code = C_ERR_FILE_SIZE;
+    goto err;
+  }
+#ifdef __linux__
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  metrics_add(metrics, C_PHASE_OPEN, start);
+
+  // a block of the reused buffer stays in the L2 between read and checksum
+  uint8_t *buf = pread_buf_get(COPY_BLOCK_SIZE);
+  if (buf == NULL) {
+    return_code = C_ERR_SYS;
+    goto err;
+  }
+  const size_t size = file_stat.st_size - FILE_HEADER_SIZE;
+  uint32_t crc32c = 0;
+  return_code = C_SUCCESS;
+  for (size_t done = 0; done < size && return_code == C_SUCCESS;
+       done += COPY_BLOCK_SIZE) {
+    const size_t block_size =
+        (size - done > COPY_BLOCK_SIZE) ? COPY_BLOCK_SIZE : size - done;
+    start = metrics_now(metrics);
+    return_code = pread_full(fd, buf, block_size, FILE_HEADER_SIZE + done);
+    metrics_add(metrics, C_PHASE_MAP, start);
+    start = metrics_now(metrics);
+    if (return_code == C_SUCCESS)
+      crc32c = cl_crc32c(crc32c, buf, block_size);
+    metrics_add(metrics, C_PHASE_CONVERT, start);
+  }
+  if (return_code == C_SUCCESS && crc32c != marker.crc32c)
+    return_code = C_ERR_CHECKSUM;
+
+err:
+  if (close(fd) < 0)
+    return_code = C_ERR_SYS;
+  return return_code;
+}
+
+// opens the destination WITHOUT truncating it, so the chunks of a file can
+// open it concurrently. every chunk preallocates its own range, the chunk
+// at the start of the pixel data copies the header
+static int open_output(const int src_fd, const char *dst_path,
+                       const size_t file_size, const size_t offset,
+                       const size_t size, int *dst_fd) {
+  int return_code = C_SUCCESS;
+  *dst_fd = open(dst_path, O_RDWR | O_CREAT, 0666);
+  if (*dst_fd < 0)
+    return C_ERR_SYS;
+
+  struct stat src_stat;
+  struct stat dst_stat;
+  if (fstat(src_fd, &src_stat) < 0 || fstat(*dst_fd, &dst_stat) < 0) {
+    return_code = C_ERR_SYS;
+    goto err;
+  }
+  if (src_stat.st_dev == dst_stat.st_dev &&
+      src_stat.st_ino == dst_stat.st_ino) {
+    return_code = C_ERR_SAME_FILE;
+    goto err;
+  }
+  // drops the stale tail of a larger file, a no-op for the other chunks
+  if ((size_t)dst_stat.st_size != file_size &&
+      ftruncate(*dst_fd, file_size) < 0) {
+    return_code = C_ERR_SYS;
+    goto err;
+  }
+#ifdef __linux__
+  // NOT every file system supports fallocate
+  if (fallocate(*dst_fd, 0, offset, size) < 0 && errno != EOPNOTSUPP) {
+    return_code = C_ERR_SYS;
+    goto err;
+  }
+#endif
+  if (offset == FILE_HEADER_SIZE)
+    return_code = copy_header(src_fd, *dst_fd);
+  if (return_code == C_SUCCESS)
+    return return_code;
+
+err:
+  close(*dst_fd);
+  return return_code;
+}
 
-int convert_file(const char *file_path) {
+int convert_file(const char *file_path, const char *out_path,
+                 cl_stats_t *stats, c_metrics_t *metrics) {
   int return_code = C_SUCCESS;
+  uint64_t start = metrics_now(metrics);
 
-  int fd = open(file_path, O_RDWR);
+  int fd = open(file_path, (out_path != NULL) ? O_RDONLY : O_RDWR);
   if (fd < 0) {
     return_code = C_ERR_SYS;
     goto err;
@@ -61,42 +991,188 @@ int convert_file(const char *file_path) {
     goto err_fd;
   }
 
-#ifdef __linux__
-  const int mmap_flags = MAP_SHARED | MAP_POPULATE;
-#else
-  const int mmap_flags = MAP_SHARED;
-#endif
-  uint8_t *file_map = (uint8_t *)mmap(NULL, file_size, PROT_READ | PROT_WRITE,
-                                      mmap_flags, fd, 0);
-  if (file_map == MAP_FAILED) {
-    return_code = C_ERR_SYS;
-    goto err_fd;
+  int dst_fd = fd;
+  if (out_path != NULL) {
+    return_code = open_output(fd, out_path, file_size, FILE_HEADER_SIZE,
+                              file_size - FILE_HEADER_SIZE, &dst_fd);
+    if (return_code < 0)
+      goto err_fd;
+  } else {
+    out_path = file_path;
   }
 
-  if (madvise(file_map, file_size, MADV_SEQUENTIAL | MADV_WILLNEED) < 0) {
+  if (stats != NULL)
+    cl_stats_reset(stats);
+  metrics_add(metrics, C_PHASE_OPEN, start);
+  uint32_t crc32c;
+  return_code =
+      convert_range(file_path, fd, out_path, dst_fd, FILE_HEADER_SIZE,
+                    file_size - FILE_HEADER_SIZE, stats, &crc32c, metrics);
+  start = metrics_now(metrics);
+  if (return_code == C_SUCCESS)
+    return_code = write_marker(dst_fd, crc32c);
+
+  if (dst_fd != fd && close(dst_fd) < 0) {
     return_code = C_ERR_SYS;
-    goto err_map;
   }
-
-  if ((return_code = u8_buf_12bit_encoded_to_log_encoded_12bit(
-           &file_map[FILE_HEADER_SIZE], file_size - FILE_HEADER_SIZE)) < 0) {
-    goto err_map;
+err_fd:
+  if (close(fd) < 0) {
+    return_code = C_ERR_SYS;
   }
 
-  if (msync(file_map, file_size, MS_SYNC) < 0) {
-    return_code = C_ERR_SYS;
+  if (return_code == C_SUCCESS && stats != NULL)
+    return_code = convert_file_write_stats(out_path, stats);
+  metrics_add(metrics, C_PHASE_SYNC, start);
+
+err:
+  return return_code;
+}
+
+int convert_file_chunk(const char *file_path, const char *out_path,
+                       const size_t offset, const size_t size,
+                       cl_stats_t *stats, uint32_t *crc32c,
+                       c_metrics_t *metrics) {
+  int return_code = C_SUCCESS;
+  uint64_t start = metrics_now(metrics);
+
+  int fd = open(file_path, (out_path != NULL) ? O_RDONLY : O_RDWR);
+  if (fd < 0)
+    return C_ERR_SYS;
+
+  int dst_fd = fd;
+  if (out_path != NULL) {
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+      return_code = C_ERR_SYS;
+      goto err_fd;
+    }
+    return_code = open_output(fd, out_path, file_stat.st_size,
+                              FILE_HEADER_SIZE + offset, size, &dst_fd);
+    if (return_code < 0)
+      goto err_fd;
+  } else {
+    out_path = file_path;
   }
 
-err_map:
-  if (munmap(file_map, file_size) < 0) {
+  metrics_add(metrics, C_PHASE_OPEN, start);
+  return_code =
+      convert_range(file_path, fd, out_path, dst_fd, FILE_HEADER_SIZE + offset,
+                    size, stats, crc32c, metrics);
+
+  start = metrics_now(metrics);
+  if (dst_fd != fd && close(dst_fd) < 0) {
     return_code = C_ERR_SYS;
   }
-
 err_fd:
   if (close(fd) < 0) {
     return_code = C_ERR_SYS;
   }
+  metrics_add(metrics, C_PHASE_OPEN, start);
+  return return_code;
+}
 
-err:
+// multiple of 96, so every full buffer is converted by the SIMD kernels
+#define STREAM_BUF_SIZE (96 * 8192)
+
+// reads until buf is full or the end of the stream, pipes return short reads
+static ssize_t read_stream(const int fd, uint8_t *buf, const size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t n = read(fd, &buf[done], size - done);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (n == 0)
+      break;
+    done += n;
+  }
+  return done;
+}
+
+static int write_stream(const int fd, const uint8_t *buf, size_t size) {
+  while (size) {
+    const ssize_t n = write(fd, buf, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return C_ERR_SYS;
+    }
+    buf += n;
+    size -= n;
+  }
+  return C_SUCCESS;
+}
+
+// the header is NOT converted, so it is moved between the pipes without
+// passing through user space
+// the header up to the marker is copied as is, the marker is replaced
+static int copy_stream_header(const int in_fd, const int out_fd) {
+  size_t left = C_MARKER_OFFSET;
+#ifdef __linux__
+  while (left) {
+    const ssize_t n = splice(in_fd, NULL, out_fd, NULL, left, SPLICE_F_MOVE);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EINVAL)
+        break; // neither end is a pipe (or e.g. O_APPEND)
+      return C_ERR_SYS;
+    }
+    if (n == 0)
+      return C_ERR_FILE_SIZE;
+    left -= n;
+  }
+#endif
+  uint8_t header[FILE_HEADER_SIZE];
+  const size_t size = left + C_MARKER_SIZE;
+  const ssize_t n = read_stream(in_fd, header, size);
+  if (n < 0)
+    return C_ERR_SYS;
+  if ((size_t)n < size)
+    return C_ERR_FILE_SIZE;
+  uint8_t *marker = &header[left];
+  if (!memcmp(marker, marker_magic, sizeof(marker_magic)))
+    return C_ERR_CONVERTED;
+  // the header leaves before the pixel data is converted, so the marker
+  // can NOT carry the checksum
+  fill_marker(marker, NULL);
+  return write_stream(out_fd, header, size);
+}
+
+int convert_stream(const int in_fd, const int out_fd, cl_stats_t *stats) {
+  int return_code = copy_stream_header(in_fd, out_fd);
+  if (return_code < 0)
+    return return_code;
+
+  uint8_t *buf = (uint8_t *)alloc_buf(32, STREAM_BUF_SIZE);
+  if (buf == NULL)
+    return C_ERR_SYS;
+  if (stats != NULL)
+    cl_stats_reset(stats);
+  size_t payload_size = 0;
+  for (;;) {
+    const ssize_t n = read_stream(in_fd, buf, STREAM_BUF_SIZE);
+    if (n < 0) {
+      return_code = C_ERR_SYS;
+      break;
+    }
+    if (n == 0)
+      break;
+    // only the last buffer may NOT be full
+    if (n % 12) {
+      return_code = C_ERR_FILE_SIZE;
+      break;
+    }
+    payload_size += n;
+    if ((return_code = convert_buf(buf, n, stats, NULL, NULL)) < 0 ||
+        (return_code = write_stream(out_fd, buf, n)) < 0)
+      break;
+  }
+  if (return_code == C_SUCCESS && payload_size == 0)
+    return_code = C_ERR_FILE_SIZE;
+
+  free(buf);
   return return_code;
 }
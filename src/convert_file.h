@@ -23,7 +23,11 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -32,12 +36,187 @@
 #define C_SUCCESS 0
 #define C_ERR_SYS -101
 #define C_ERR_FILE_SIZE -102
+#define C_ERR_SAME_FILE -103
+#define C_ERR_CONVERTED -104
+#define C_ERR_CHECKSUM -105
+#define C_ERR_NO_CHECKSUM -106
+
+#define FILE_HEADER_SIZE 512
+
+// the last bytes of the header are reserved for the conversion marker,
+// a converted file is recognized without reading its pixel data
+#define C_MARKER_SIZE 16
+#define C_MARKER_OFFSET (FILE_HEADER_SIZE - C_MARKER_SIZE)
+// version 2 carries the CRC32C of the converted pixel data,
+// version 1 (e.g. written by convert_stream) carries none
+#define C_MARKER_VERSION 2
+#define C_MARKER_VERSION_NO_CRC 1
+// curve IDs of the marker
+#define C_CURVE_LOG_ENCODED_12BIT 1
+
+// I/O backends
+#define C_IO_MMAP 0
+#define C_IO_URING 1
+
+// durability policies
+#define C_DURABILITY_FILE 0  // every file is synced before it is reported
+#define C_DURABILITY_BATCH 1 // the writeback only starts per file
+#define C_DURABILITY_NONE 2  // the page cache writes back on its own
+
+// phases of a conversion timed by c_metrics_t
+#define C_PHASE_OPEN 0    // opening the files, preparing the output
+#define C_PHASE_MAP 1     // mapping, reading and writing the pixel data
+#define C_PHASE_CONVERT 2 // the conversion kernel (with the checksum)
+#define C_PHASE_SYNC 3    // the writeback, the marker and the sidecar
+#define C_PHASES 4
+
+typedef struct c_metrics {
+  uint64_t phase_ns[C_PHASES]; // accumulated, so the chunks add up
+} c_metrics_t;
+
+typedef struct c_marker {
+  uint16_t curve;
+  uint16_t version;
+  uint32_t crc32c; // of the pixel data, 0 before C_MARKER_VERSION
+} c_marker_t;
 
 const char *c_error_message_from_return_code(int return_code);
 
 /**
+ * e.g. "convert" for C_PHASE_CONVERT, NULL for an unknown phase
+ **/
+const char *c_phase_name(int phase);
+
+/**
+ * selects the I/O backend of the following conversions, C_IO_MMAP is the
+ * default. C_IO_URING reads and writes the pixel data asynchronously
+ * (O_DIRECT where supported) with several pieces of a file in flight
+ * IMPORTANT: NOT thread safe, select the backend before the conversions
+ * IMPORTANT: on C_ERR_SYS the backend is NOT supported, check errno
+ **/
+int convert_file_set_io(int io);
+
+/**
+ * the mmap backend maps and converts files in windows of window bytes
+ * (rounded down to a multiple of 96), 0 maps the whole range at once
+ * IMPORTANT: NOT thread safe, select the window before the conversions
+ **/
+void convert_file_set_mmap_window(size_t window);
+
+/**
+ * the mmap backend reads ranges of at most threshold bytes into a reused
+ * buffer of the thread (pread) and writes them back (pwrite) instead of
+ * mapping them, 0 maps every range
+ * IMPORTANT: NOT thread safe, select the threshold before the conversions
+ **/
+void convert_file_set_pread_threshold(size_t threshold);
+
+/**
+ * advises huge pages (MADV_HUGEPAGE) for the file mappings and backs the
+ * buffers of the io_uring backend, of the pread path and of convert_stream
+ * with huge pages
+ * IMPORTANT: NOT thread safe, select the option before the conversions
+ **/
+void convert_file_set_huge_pages(bool enable);
+
+/**
+ * selects when the converted data is made durable, C_DURABILITY_FILE is
+ * the default
+ * IMPORTANT: NOT thread safe, select the policy before the conversions
+ **/
+void convert_file_set_durability(int mode);
+
+/**
+ * syncs the file system holding path (syncfs), so the conversions of
+ * C_DURABILITY_BATCH on that file system are durable
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file_sync_fs(const char *path);
+
+/**
+ * hints the kernel to read the size bytes of pixel data at offset (relative
+ * to the end of the header) of file_path into the page cache, so a later
+ * conversion finds them cached. size 0 reads ahead up to the end of the file.
+ * the io_uring backend bypasses the page cache, so it skips the hint
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file_readahead(const char *file_path, size_t offset, size_t size);
+
+/**
+ * reads the conversion marker of file_path with a single pread of the
+ * reserved header bytes, returns 1 and fills marker (if NOT NULL) if the
+ * file was converted, 0 if NOT
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file_read_marker(const char *file_path, c_marker_t *marker);
+
+/**
+ * stamps the conversion marker (C_CURVE_LOG_ENCODED_12BIT, C_MARKER_VERSION)
+ * with the CRC32C of the pixel data into the header of file_path.
+ * convert_file stamps its output itself, a file converted by chunks has to be
+ * stamped after its last chunk.
+ * with C_DURABILITY_FILE the marker is synced, so it never reaches the
+ * disk before the pixel data
+ * the time is added to the sync phase of metrics (if NOT NULL)
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file_mark(const char *file_path, uint32_t crc32c,
+                      c_metrics_t *metrics);
+
+/**
+ * checks the pixel data of a converted file against the CRC32C of its
+ * marker without converting anything, returns C_ERR_CHECKSUM on a mismatch
+ * and C_ERR_NO_CHECKSUM if the file carries no checksum (NOT converted or
+ * converted by convert_stream). the read is timed as the map phase and the
+ * checksum as the convert phase of metrics (if NOT NULL)
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file_verify(const char *file_path, c_metrics_t *metrics);
+
+/**
+ * converts the file in-place if out_path is NULL, otherwise the file is only
+ * read and the converted copy is written to out_path.
+ * if stats is NOT NULL the statistics of the converted pixels are
+ * written to the sidecar file <out_path or file_path>.stats.
+ * the converted file is stamped with the conversion marker, which carries the
+ * CRC32C of the converted pixels (computed during the conversion).
+ * the time of every phase is added to metrics (if NOT NULL)
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file(const char *file_path, const char *out_path,
+                 cl_stats_t *stats, c_metrics_t *metrics);
+
+/**
+ * converts the size bytes of pixel data at offset (relative to the end of
+ * the header) in-place or into out_path (if NOT NULL), other chunks of the
+ * same file may be converted concurrently.
+ * the statistics are accumulated into stats (if NOT NULL), the CRC32C of the
+ * converted chunk is written to crc32c (if NOT NULL), the chunks of a file
+ * are combined with cl_crc32c_combine. the time of every phase is added to
+ * metrics (if NOT NULL)
+ * IMPORTANT: offset must be a multiple of 96 and size a multiple of 12
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_file_chunk(const char *file_path, const char *out_path,
+                       size_t offset, size_t size, cl_stats_t *stats,
+                       uint32_t *crc32c, c_metrics_t *metrics);
+
+/**
+ * converts a raw file streamed from in_fd (e.g. a pipe) and writes it
+ * to out_fd, nothing has to be seekable or mmap-able. the header of the
+ * output carries the conversion marker (without a checksum, the header is
+ * written before the pixel data), a stream carrying it already is
+ * rejected (C_ERR_CONVERTED).
+ * the statistics are written to stats (if NOT NULL)
+ * IMPORTANT: on error the output is incomplete
+ * IMPORTANT: on C_ERR_SYS check errno
+ **/
+int convert_stream(int in_fd, int out_fd, cl_stats_t *stats);
+
+/**
+ * writes the sidecar file <file_path>.stats
  * IMPORTANT: on C_ERR_SYS check errno
  **/
-int convert_file(const char *file_path);
+int convert_file_write_stats(const char *file_path, const cl_stats_t *stats);
 
 #endif
@@ -16,100 +16,993 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "arena.h"
 #include "convert_file.h"
+#include "metrics.h"
 #include "queue.h"
+#include "trace.h"
+#include "walk.h"
 #include <errno.h>
 #include <getopt.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #define DELIMITER '\n'
 #define OPTION_VERBOSE (1 << 0)
 #define OPTION_STDIN (1 << 1)
+#define OPTION_STATS (1 << 2)
+#define OPTION_IO_URING (1 << 3)
+#define OPTION_PIPE (1 << 4)
+#define OPTION_FORCE (1 << 5)
+#define OPTION_VERIFY (1 << 6)
+#define OPTION_METRICS (1 << 7)
+#define OPTION_PROGRESS (1 << 8)
 
-static lf_ow_queue_t queue = {0};
-static pthread_t *threads = NULL;
+// files with more pixel data than chunk_size are split into chunks which are
+// scheduled like whole files, so a single huge file keeps every worker busy
+#define CHUNK_SIZE_DEFAULT_MIB 64
+#define CHUNK_ALIGN (12 * 8) // one AVX2 block
+// the mmap backend maps a task in windows, so the conversion starts after
+// faulting in the first window and the RSS of a worker stays bounded
+#define WINDOW_SIZE_DEFAULT_MIB 16
+// smaller tasks are read into a buffer instead, for them the mapping costs
+// more than the conversion
+#define SMALL_FILE_DEFAULT_MIB 4
+
+// the main thread produces the tasks while the workers already consume them,
+// a full queue only blocks the producer
+#define QUEUE_CAPACITY 1024
+#define RBUF_SIZE 4096
+// the queue hands out the tasks in push order, so the next tasks are known
+// and can be read into the page cache while the current ones are converted
+#define READAHEAD_DEFAULT 4
+// the live statistics file is rewritten every interval
+#define LIVE_STATS_INTERVAL_DEFAULT_S 10
+// the progress line is refreshed at a fixed rate
+#define PROGRESS_INTERVAL_MS 500
+// 32 bytes per span, the ring of a thread keeps its latest spans
+#define TRACE_SPANS_PER_THREAD (1 << 16)
+
+typedef struct convert_job {
+  struct convert_job *next; // every job is freed at shutdown
+  _Atomic size_t chunks_left;
+  _Atomic int return_code;
+  // the CRC32C of every chunk shifted over the pixel data following it,
+  // xor-ed together it is the CRC32C of the file no matter the chunk order
+  _Atomic uint32_t crc32c;
+  size_t data_size;
+  size_t n_chunks;
+  _Atomic uint64_t start_ns; // of the first chunk, for --metrics
+  pthread_mutex_t stats_lock; // guards stats and metrics
+  cl_stats_t *stats;
+  c_metrics_t metrics;
+} convert_job_t;
+
+typedef struct convert_task {
+  const char *file_path;
+  const char *out_path; // NULL if the file is converted in-place
+  convert_job_t *job; // NULL if the whole file is converted at once
+  size_t offset;
+  size_t size; // of the pixel data, 0 if the size is unknown
+  size_t seq;  // position in the push order
+} convert_task_t;
+
+// a path on every file system written with the batch durability policy
+typedef struct sync_target {
+  dev_t dev;
+  const char *path;
+} sync_target_t;
+
+typedef struct worker {
+  pthread_t tid;
+  int index;
+  cl_stats_t *stats; // every worker owns its statistics sink
+  metrics_sink_t metrics;
+  metrics_counters_t *counters; // read by the live statistics
+} worker_t;
+
+static lf_mpmc_queue_t queue = {0};
+// file paths read from STDIN and the tasks live until shutdown
+static arena_t arena = {0};
+static convert_job_t *jobs = NULL;
+// the paths found by -r live in the walk until shutdown
+static walk_t walk = {0};
+static bool walk_is_init = false;
+static _Atomic size_t num_tasks_pushed = 0;
+static _Atomic size_t num_tasks_done = 0;
+static _Atomic size_t num_tasks_failed = 0;
+// the pixel data of the pushed tasks, the total of the progress line
+static _Atomic uint64_t num_bytes_pushed = 0;
+static _Atomic bool pushing_done = false;
+static _Atomic size_t num_walk_errors = 0;
+// files missing from the batch metrics
+static _Atomic size_t num_metrics_errors = 0;
+// the walking threads plan files concurrently, only the allocations shared
+// by every file are serialized
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+// the output paths handed out so far (open addressing, guarded by
+// plan_lock), two inputs mapped to the same output would corrupt it
+static const char **output_paths = NULL;
+static size_t output_paths_capacity = 0; // a power of 2
+static size_t num_output_paths = 0;
+// the files converted in-place so far by device and inode (open addressing,
+// guarded by plan_lock), a file given twice would be converted twice
+typedef struct file_id {
+  dev_t dev;
+  ino_t ino;
+  bool used;
+} file_id_t;
+static file_id_t *input_files = NULL;
+static size_t input_files_capacity = 0; // a power of 2
+static size_t num_input_files = 0;
+// the pushed tasks by seq, an entry is only valid if its seq matches
+static const convert_task_t *_Atomic readahead_ring[QUEUE_CAPACITY] = {0};
+static _Atomic size_t readahead_next = 0; // seq of the next task to hint
+static size_t readahead = READAHEAD_DEFAULT;
+static const char *output_dir = NULL;
+static int durability = C_DURABILITY_FILE;
+static sync_target_t *sync_targets = NULL;
+static size_t num_sync_targets = 0;
+static size_t chunk_size =
+    ((size_t)CHUNK_SIZE_DEFAULT_MIB << 20) / CHUNK_ALIGN * CHUNK_ALIGN;
+static worker_t *workers = NULL;
+static metrics_counters_t *counters = NULL; // one cache line per worker
+static int num_started = 0;
+static uint64_t batch_start_ns = 0;
+// a snapshot of the counters is printed to STDERR on SIGUSR1 and written to
+// live_stats_path (if NOT NULL) every interval
+static const char *live_stats_path = NULL;
+static unsigned long live_stats_interval = LIVE_STATS_INTERVAL_DEFAULT_S;
+static pthread_t live_stats_tid;
+static bool live_stats_started = false;
+static _Atomic bool live_stats_stop = false;
+static const char *trace_path = NULL;
+static pthread_t progress_tid;
+static bool progress_started = false;
+static bool progress_stop = false; // guarded by progress_lock
+static pthread_mutex_t progress_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t progress_cond = PTHREAD_COND_INITIALIZER;
 static int num_threads = 1;
+// the directories given by -r and the filters of their files (argv strings)
+static const char **walk_dirs = NULL;
+static size_t num_walk_dirs = 0;
+static const char **walk_globs = NULL;
+static size_t num_walk_globs = 0;
+static const char **walk_exts = NULL;
+static size_t num_walk_exts = 0;
 static int return_code = 0;
 static int options = 0;
 
-static const char *shortopts = "hit:v";
+static const char *shortopts = "a:c:d:e:fg:hHil:L:m:o:pPr:sS:t:T:uvVw:";
 static const struct option long_options[] = {
+    {"readahead", required_argument, NULL, 'a'},
+    {"chunk-size", required_argument, NULL, 'c'},
+    {"durability", required_argument, NULL, 'd'},
+    {"ext", required_argument, NULL, 'e'},
+    {"force", no_argument, NULL, 'f'},
+    {"glob", required_argument, NULL, 'g'},
     {"help", no_argument, NULL, 'h'},
+    {"huge-pages", no_argument, NULL, 'H'},
     {"input", no_argument, NULL, 'i'},
+    {"live-stats", required_argument, NULL, 'l'},
+    {"live-interval", required_argument, NULL, 'L'},
+    {"metrics", required_argument, NULL, 'm'},
+    {"output-dir", required_argument, NULL, 'o'},
+    {"pipe", no_argument, NULL, 'p'},
+    {"progress", no_argument, NULL, 'P'},
+    {"recursive", required_argument, NULL, 'r'},
+    {"stats", no_argument, NULL, 's'},
+    {"small-file", required_argument, NULL, 'S'},
     {"threads", required_argument, NULL, 't'},
+    {"trace", required_argument, NULL, 'T'},
+    {"io-uring", no_argument, NULL, 'u'},
     {"verbose", no_argument, NULL, 'v'},
+    {"verify", no_argument, NULL, 'V'},
+    {"window", required_argument, NULL, 'w'},
     {NULL, 0, NULL, 0},
 };
 
-static const char *usage = "Usage: %s [--help (-h)] [--input (-i)] [--threads "
-                           "(-t) <threads>] [--verbose (-v)]\n";
+static const char *usage =
+    "Usage: %s [--readahead (-a) <tasks>] [--chunk-size (-c) <MiB>] "
+    "[--durability (-d) <per-file|batch|none>] [--ext (-e) <extension>] "
+    "[--force (-f)] [--glob (-g) <pattern>] [--help (-h)] "
+    "[--huge-pages (-H)] [--input (-i)] [--live-stats (-l) <file>] "
+    "[--live-interval (-L) <seconds>] [--metrics (-m) <json>] "
+    "[--output-dir (-o) <dir>] "
+    "[--pipe (-p)] [--progress (-P)] [--recursive (-r) <dir>] "
+    "[--stats (-s)] "
+    "[--small-file (-S) <MiB, 0 maps every task>] "
+    "[--threads (-t) <threads>] [--trace (-T) <file>] [--io-uring (-u)] "
+    "[--verbose (-v)] "
+    "[--verify (-V)] [--window (-w) <MiB, 0 maps a task at once>]\n"
+    "  --recursive (-r) converts the files below <dir>, the --output-dir is "
+    "skipped if it is inside <dir>\n";
 
 #define PRINT_SYS_ERR                                                          \
   if (errno) {                                                                 \
     fprintf(stderr, "System error: %s\n", strerror(errno));                    \
   }
 
+// one JSON line per finished file, its latency is kept for the batch
+static void record_file(worker_t *worker, const char *file_path,
+                        const size_t bytes, const size_t chunks,
+                        const uint64_t start_ns, const c_metrics_t *metrics) {
+  metrics_file_t file = {
+      .path = file_path,
+      .bytes = bytes,
+      .chunks = chunks,
+      .latency_ns = metrics_now_ns() - start_ns,
+      .phases = *metrics,
+      .thread = worker->index,
+  };
+  metrics_print_file(stdout, &file);
+  // on a malloc error neither the latency nor the bytes and phases of the
+  // file are added, so the whole batch line is short of the file
+  if (metrics_sink_add(&worker->metrics, &file) != 0) {
+    fprintf(stderr, "Error recording the metrics of: %s\n", file_path);
+    PRINT_SYS_ERR;
+    atomic_fetch_add(&num_metrics_errors, 1);
+  }
+}
+
+// the phases of the chunk are added to metrics, *file_done is set by the
+// last chunk of a converted file
+static int convert_chunk(const convert_task_t *task, worker_t *worker,
+                         c_metrics_t *metrics, bool *file_done) {
+  convert_job_t *job = task->job;
+  cl_stats_t *stats = worker->stats;
+  if (options & OPTION_METRICS) {
+    uint64_t start_ns = 0;
+    atomic_compare_exchange_strong(&job->start_ns, &start_ns,
+                                   metrics_now_ns());
+  }
+  if (stats != NULL)
+    cl_stats_reset(stats);
+  uint32_t crc32c;
+  int ret =
+      convert_file_chunk(task->file_path, task->out_path, task->offset,
+                         task->size, stats, &crc32c, metrics);
+  if (ret < 0) {
+    atomic_store(&job->return_code, ret);
+  } else {
+    atomic_fetch_xor(&job->crc32c,
+                     cl_crc32c_combine(crc32c, 0,
+                                       job->data_size - task->offset -
+                                           task->size));
+    if (stats != NULL || (options & OPTION_METRICS)) {
+      pthread_mutex_lock(&job->stats_lock);
+      if (stats != NULL)
+        cl_stats_merge(job->stats, stats);
+      for (int i = 0; i < C_PHASES; ++i)
+        job->metrics.phase_ns[i] += metrics->phase_ns[i];
+      pthread_mutex_unlock(&job->stats_lock);
+    }
+  }
+  // the last chunk writes the statistics of the whole file and stamps it
+  // as converted, so an interrupted file is NOT skipped on the next run.
+  // every other chunk is done, so the job is NOT locked anymore
+  if (atomic_fetch_sub(&job->chunks_left, 1) == 1 &&
+      atomic_load(&job->return_code) == C_SUCCESS) {
+    const char *path =
+        (task->out_path != NULL) ? task->out_path : task->file_path;
+    c_metrics_t mark_metrics = {0};
+    if (job->stats != NULL)
+      ret = convert_file_write_stats(path, job->stats);
+    if (ret == C_SUCCESS)
+      ret = convert_file_mark(path, atomic_load(&job->crc32c), &mark_metrics);
+    metrics->phase_ns[C_PHASE_SYNC] += mark_metrics.phase_ns[C_PHASE_SYNC];
+    job->metrics.phase_ns[C_PHASE_SYNC] += mark_metrics.phase_ns[C_PHASE_SYNC];
+    *file_done = ret == C_SUCCESS;
+    if (ret == C_SUCCESS && (options & OPTION_METRICS))
+      record_file(worker, task->file_path, job->data_size, job->n_chunks,
+                  atomic_load(&job->start_ns), &job->metrics);
+  }
+  return ret;
+}
+
+static void print_error(const char *file_path, const int ret) {
+  switch (ret) {
+  case C_ERR_SYS:
+    fprintf(stderr, "A system error occurend while processing: %s\n",
+            file_path);
+    PRINT_SYS_ERR;
+    break;
+  case C_ERR_FILE_SIZE:
+    fprintf(stderr, "Unable to process file: %s\n", file_path);
+    break;
+  case C_ERR_SAME_FILE:
+    fprintf(stderr, "The output file is the input file: %s\n", file_path);
+    break;
+  case C_ERR_CONVERTED:
+    fprintf(stderr, "The file is already converted: %s\n", file_path);
+    break;
+  case C_ERR_CHECKSUM:
+    fprintf(stderr, "The checksum does NOT match: %s\n", file_path);
+    break;
+  case C_ERR_NO_CHECKSUM:
+    fprintf(stderr, "The file carries no checksum: %s\n", file_path);
+    break;
+  default:
+    fprintf(stderr, "An internal error occurend while processing: %s\n",
+            file_path);
+    const char *msg = c_error_message_from_return_code(ret);
+    if (msg != NULL)
+      fprintf(stderr, "Internal error: %s\n", msg);
+  }
+}
+
+// hints the readahead tasks following seq, every task is hinted once no
+// matter which worker gets there first. the tasks NOT pushed yet are hinted
+// by a later call
+static void readahead_tasks(const size_t seq) {
+  const size_t end = seq + 1 + readahead;
+  size_t next = atomic_load(&readahead_next);
+  while (next < end) {
+    // the workers got ahead of the hints, the skipped tasks are started
+    if (next <= seq) {
+      atomic_compare_exchange_weak(&readahead_next, &next, seq + 1);
+      continue;
+    }
+    const convert_task_t *task =
+        atomic_load(&readahead_ring[next % QUEUE_CAPACITY]);
+    if (task == NULL || task->seq != next)
+      break;
+    if (!atomic_compare_exchange_weak(&readahead_next, &next, next + 1))
+      continue;
+    // only a hint, a failure shows up in the conversion of the task
+    convert_file_readahead(task->file_path, task->offset, task->size);
+    ++next;
+  }
+}
+
 static void *worker_thread(void *ctx) {
-  lf_ow_queue_t *queue = (lf_ow_queue_t *)ctx;
-  const char *file_path;
-  while ((file_path = lf_ow_queue_pop(queue)) != NULL) {
-    if (options & OPTION_VERBOSE)
-      printf("* Start processing: %s\n", file_path);
+  worker_t *worker = (worker_t *)ctx;
+  trace_thread("worker", worker->index);
+  const convert_task_t *task;
+  uint64_t wait_start = trace_begin();
+  while ((task = lf_mpmc_queue_pop(&queue)) != NULL) {
+    trace_end("wait", NULL, wait_start);
+    const uint64_t task_start = trace_begin();
+    const char *file_path = task->file_path;
+    if (readahead) {
+      const uint64_t readahead_start = trace_begin();
+      readahead_tasks(task->seq);
+      trace_end("readahead", NULL, readahead_start);
+    }
+    if (options & OPTION_VERBOSE) {
+      if (task->job != NULL)
+        printf("* Start processing: %s [%zu, %zu)\n", file_path, task->offset,
+               task->offset + task->size);
+      else
+        printf("* Start processing: %s\n", file_path);
+    }
+    // the phases are always timed for the live counters, a few clock reads
+    // per task
+    const uint64_t start_ns =
+        (options & OPTION_METRICS) ? metrics_now_ns() : 0;
+    c_metrics_t metrics = {0};
+    bool file_done = task->job == NULL;
     int ret;
-    if ((ret = convert_file(file_path)) < 0) {
-      switch (ret) {
-      case C_ERR_SYS:
-        fprintf(stderr, "A system error occurend while processing: %s\n",
-                file_path);
-        PRINT_SYS_ERR;
-        break;
-      case C_ERR_FILE_SIZE:
-        fprintf(stderr, "Unable to process file: %s\n", file_path);
-        break;
-      default:
-        fprintf(stderr, "An internal error occurend while processing: %s\n",
-                file_path);
-        const char *msg = c_error_message_from_return_code(ret);
-        if (msg != NULL)
-          fprintf(stderr, "Internal error: %s\n", msg);
-      }
+    if (options & OPTION_VERIFY)
+      ret = convert_file_verify(file_path, &metrics);
+    else if (task->job != NULL)
+      ret = convert_chunk(task, worker, &metrics, &file_done);
+    else
+      ret = convert_file(file_path, task->out_path, worker->stats, &metrics);
+    // the last chunk of a file records the whole file
+    if (ret >= 0 && (options & OPTION_METRICS) && task->job == NULL)
+      record_file(worker, file_path, task->size, 1, start_ns, &metrics);
+    metrics_counters_add(worker->counters, ret >= 0 && file_done,
+                         (ret >= 0) ? task->size : 0, ret < 0, &metrics);
+    if (ret < 0) {
+      print_error(file_path, ret);
+      atomic_fetch_add(&num_tasks_failed, 1);
+    } else if (options & OPTION_VERIFY && options & OPTION_VERBOSE) {
+      printf("* Checksum matches: %s\n", file_path);
     }
+    const size_t num_done = atomic_fetch_add(&num_tasks_done, 1) + 1;
     if (options & OPTION_VERBOSE) {
+      // while STDIN is read the total is NOT known yet
       printf("* Finished processing: %s\n", file_path);
-      printf("* Finished: %f%%\n", lf_ow_queue_percentage(queue));
+      printf("* Finished: %f%%\n",
+             (float)num_done / atomic_load(&num_tasks_pushed) * 100.0f);
     }
+    trace_end("task", file_path, task_start);
+    wait_start = trace_begin();
   }
   return NULL;
 }
 
-#define FPATH_BUF_SIZE 256
-#define RPATH_BUF_SIZE 4096
+static void snapshot_live_stats(const bool to_file, const bool to_stderr) {
+  const uint64_t uptime_ns = metrics_now_ns() - batch_start_ns;
+  if (to_stderr &&
+      metrics_print_snapshot(stderr, counters, num_started, uptime_ns) != 0)
+    fprintf(stderr, "Error printing the live statistics\n");
+  if (to_file && live_stats_path != NULL &&
+      metrics_write_snapshot(live_stats_path, counters, num_started,
+                             uptime_ns) != 0) {
+    fprintf(stderr, "Error writing the live statistics: %s\n",
+            live_stats_path);
+    PRINT_SYS_ERR;
+  }
+}
+
+// SIGUSR1 is blocked in every thread and only taken by sigwait here, so
+// the snapshot is NOT written from a signal handler. the last snapshot is
+// written when the batch is done
+static void *live_stats_thread(void *ctx) {
+  (void)ctx;
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  const struct timespec interval = {.tv_sec = live_stats_interval};
+  for (;;) {
+    const int sig = (live_stats_path != NULL && live_stats_interval)
+                        ? sigtimedwait(&set, NULL, &interval)
+                        : sigwaitinfo(&set, NULL);
+    if (atomic_load(&live_stats_stop)) {
+      snapshot_live_stats(true, false);
+      break;
+    }
+    if (sig == SIGUSR1)
+      snapshot_live_stats(true, true);
+    else if (sig < 0 && errno == EAGAIN)
+      snapshot_live_stats(true, false);
+  }
+  return NULL;
+}
+
+static void stop_live_stats(void) {
+  if (!live_stats_started)
+    return;
+  atomic_store(&live_stats_stop, true);
+  pthread_kill(live_stats_tid, SIGUSR1);
+  pthread_join(live_stats_tid, NULL);
+  live_stats_started = false;
+}
+
+// the bytes of the finished tasks, every counter is read atomically
+static uint64_t bytes_done(void) {
+  uint64_t bytes = 0;
+  for (int i = 0; i < num_threads; ++i)
+    bytes += atomic_load_explicit(&counters[i].bytes, memory_order_relaxed);
+  return bytes;
+}
+
+// a total still growing (e.g. STDIN is read) is marked with a +
+static void print_progress(const bool tty, const uint64_t done,
+                           const uint64_t elapsed_ns, const double mb_per_s) {
+  const uint64_t total = atomic_load(&num_bytes_pushed);
+  const bool total_known = atomic_load(&pushing_done);
+  const double avg_mb_per_s = elapsed_ns ? (double)done / elapsed_ns * 1e3 : 0;
+  fprintf(stderr, "%s%.1f / %.1f%s MB (%.1f%%) %.1f MB/s (avg %.1f MB/s)",
+          tty ? "\r" : "", done / 1e6, total / 1e6, total_known ? "" : "+",
+          total ? (double)done / total * 100.0 : 0.0, mb_per_s, avg_mb_per_s);
+  if (avg_mb_per_s > 0 && total >= done) {
+    const uint64_t eta_s = (total - done) / 1e6 / avg_mb_per_s;
+    fprintf(stderr, " ETA %" PRIu64 ":%02" PRIu64 ":%02" PRIu64, eta_s / 3600,
+            eta_s / 60 % 60, eta_s % 60);
+  }
+  // a shorter line overwrites the end of the previous one on a terminal
+  fputs(tty ? "\033[K" : "\n", stderr);
+  fflush(stderr);
+}
+
+// the only writer of the progress line, so the workers print nothing of it.
+// the current rate covers the last interval, the ETA uses the average
+static void *progress_thread(void *ctx) {
+  (void)ctx;
+  const bool tty = isatty(STDERR_FILENO);
+  uint64_t last_ns = batch_start_ns;
+  uint64_t last_bytes = 0;
+  pthread_mutex_lock(&progress_lock);
+  for (;;) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)PROGRESS_INTERVAL_MS * 1000000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+    while (!progress_stop &&
+           pthread_cond_timedwait(&progress_cond, &progress_lock,
+                                  &deadline) == 0)
+      ;
+    const uint64_t now_ns = metrics_now_ns();
+    const uint64_t done = bytes_done();
+    const double mb_per_s =
+        (now_ns > last_ns)
+            ? (double)(done - last_bytes) / (now_ns - last_ns) * 1e3
+            : 0.0;
+    print_progress(tty, done, now_ns - batch_start_ns, mb_per_s);
+    last_ns = now_ns;
+    last_bytes = done;
+    if (progress_stop)
+      break;
+  }
+  pthread_mutex_unlock(&progress_lock);
+  if (tty)
+    fputc('\n', stderr);
+  return NULL;
+}
+
+// prints the final line
+static void stop_progress(void) {
+  if (!progress_started)
+    return;
+  pthread_mutex_lock(&progress_lock);
+  progress_stop = true;
+  pthread_cond_signal(&progress_cond);
+  pthread_mutex_unlock(&progress_lock);
+  pthread_join(progress_tid, NULL);
+  progress_started = false;
+}
+
+static void free_job(convert_job_t *job) {
+  pthread_mutex_destroy(&job->stats_lock);
+  cl_stats_free(job->stats);
+  free(job);
+}
+
+static convert_job_t *alloc_job(const size_t n_chunks,
+                                const size_t data_size) {
+  convert_job_t *job = (convert_job_t *)calloc(1, sizeof(convert_job_t));
+  if (job == NULL)
+    return NULL;
+  atomic_init(&job->chunks_left, n_chunks);
+  atomic_init(&job->return_code, C_SUCCESS);
+  atomic_init(&job->crc32c, 0);
+  atomic_init(&job->start_ns, 0);
+  job->data_size = data_size;
+  job->n_chunks = n_chunks;
+  if (pthread_mutex_init(&job->stats_lock, NULL) != 0) {
+    free(job);
+    return NULL;
+  }
+  if ((options & OPTION_STATS) && cl_stats_create(&job->stats) < 0) {
+    free_job(job);
+    return NULL;
+  }
+  job->next = jobs;
+  jobs = job;
+  return job;
+}
+
+static const char *base_name(const char *file_path) {
+  const char *slash = strrchr(file_path, '/');
+  return (slash != NULL) ? slash + 1 : file_path;
+}
+
+// <output_dir>/<out_name>
+static char *output_path(const char *out_name) {
+  const size_t dir_len = strlen(output_dir);
+  const size_t name_len = strlen(out_name);
+  char *out_path = (char *)arena_alloc(&arena, dir_len + name_len + 2);
+  if (out_path == NULL)
+    return NULL;
+  memcpy(out_path, output_dir, dir_len);
+  out_path[dir_len] = '/';
+  memcpy(&out_path[dir_len + 1], out_name, name_len + 1);
+  return out_path;
+}
+
+// creates the directories of path the slashes after path[start] end, an
+// existing directory is NOT an error
+static int make_dirs(char *path, const size_t start) {
+  for (char *slash = strchr(&path[start], '/'); slash != NULL;
+       slash = strchr(slash + 1, '/')) {
+    *slash = 0;
+    const int ret = mkdir(path, 0777);
+    *slash = '/';
+    if (ret != 0 && errno != EEXIST)
+      return -1;
+  }
+  return 0;
+}
+
+// the subdirectories of out_path below output_dir
+static int make_output_dirs(char *out_path) {
+  return make_dirs(out_path, strlen(output_dir) + 1);
+}
+
+// output_dir and its missing parents (mkdir -p)
+static int make_output_dir(void) {
+  const size_t dir_len = strlen(output_dir);
+  char *path = (char *)malloc(dir_len + 2);
+  if (path == NULL)
+    return -1;
+  memcpy(path, output_dir, dir_len);
+  path[dir_len] = '/';
+  path[dir_len + 1] = 0;
+  // the root directory always exists
+  const int ret = make_dirs(path, 1);
+  free(path);
+  return ret;
+}
+
+// FNV-1a
+static size_t hash_path(const char *path) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (; *path; ++path)
+    hash = (hash ^ (unsigned char)*path) * 1099511628211ULL;
+  return (size_t)hash;
+}
+
+static void insert_output_path(const char **paths, const size_t capacity,
+                               const char *out_path) {
+  size_t i = hash_path(out_path) & (capacity - 1);
+  while (paths[i] != NULL)
+    i = (i + 1) & (capacity - 1);
+  paths[i] = out_path;
+}
+
+// returns 1 if out_path was handed out before, -1 on a malloc error
+// IMPORTANT: hold plan_lock
+static int claim_output_path(const char *out_path) {
+  if ((num_output_paths + 1) * 2 > output_paths_capacity) {
+    const size_t capacity =
+        output_paths_capacity ? output_paths_capacity << 1 : 1024;
+    const char **paths = (const char **)calloc(capacity, sizeof(char *));
+    if (paths == NULL)
+      return -1;
+    for (size_t i = 0; i < output_paths_capacity; ++i) {
+      if (output_paths[i] != NULL)
+        insert_output_path(paths, capacity, output_paths[i]);
+    }
+    free(output_paths);
+  free(input_files);
+    output_paths = paths;
+    output_paths_capacity = capacity;
+  }
+  for (size_t i = hash_path(out_path) & (output_paths_capacity - 1);
+       output_paths[i] != NULL; i = (i + 1) & (output_paths_capacity - 1)) {
+    if (strcmp(output_paths[i], out_path) == 0)
+      return 1;
+  }
+  insert_output_path(output_paths, output_paths_capacity, out_path);
+  ++num_output_paths;
+  return 0;
+}
+
+static int add_sync_target(const dev_t dev, const char *path) {
+  for (size_t i = 0; i < num_sync_targets; ++i) {
+    if (sync_targets[i].dev == dev)
+      return 0;
+  }
+  sync_target_t *new_sync_targets = (sync_target_t *)realloc(
+      sync_targets, sizeof(sync_target_t) * (num_sync_targets + 1));
+  if (new_sync_targets == NULL)
+    return -1;
+  sync_targets = new_sync_targets;
+  sync_targets[num_sync_targets].dev = dev;
+  sync_targets[num_sync_targets++].path = path;
+  return 0;
+}
+
+// a converted input would be converted twice, a converted output is left
+// over from an interrupted batch
+static bool is_converted(const char *file_path, const char *out_path) {
+  c_marker_t marker;
+  if (convert_file_read_marker(file_path, &marker) != 1 &&
+      (out_path == NULL ||
+       convert_file_read_marker(out_path, &marker) != 1))
+    return false;
+  if (options & OPTION_VERBOSE)
+    printf("* Skipping converted file: %s (curve %u, version %u)\n",
+           file_path, marker.curve, marker.version);
+  return true;
+}
+
+static size_t hash_file_id(const dev_t dev, const ino_t ino) {
+  uint64_t hash = (uint64_t)ino * 0x9E3779B97F4A7C15ULL ^ (uint64_t)dev;
+  return (size_t)(hash ^ (hash >> 32));
+}
+
+static void insert_input_file(file_id_t *ids, const size_t capacity,
+                              const dev_t dev, const ino_t ino) {
+  size_t i = hash_file_id(dev, ino) & (capacity - 1);
+  while (ids[i].used)
+    i = (i + 1) & (capacity - 1);
+  ids[i] = (file_id_t){.dev = dev, .ino = ino, .used = true};
+}
+
+// returns 1 if the file was claimed before (also by a hard link or another
+// path), -1 on a malloc error
+// IMPORTANT: hold plan_lock
+static int claim_input_file(const dev_t dev, const ino_t ino) {
+  if ((num_input_files + 1) * 2 > input_files_capacity) {
+    const size_t capacity =
+        input_files_capacity ? input_files_capacity << 1 : 1024;
+    file_id_t *ids = (file_id_t *)calloc(capacity, sizeof(file_id_t));
+    if (ids == NULL)
+      return -1;
+    for (size_t i = 0; i < input_files_capacity; ++i) {
+      if (input_files[i].used)
+        insert_input_file(ids, capacity, input_files[i].dev,
+                          input_files[i].ino);
+    }
+    free(input_files);
+    input_files = ids;
+    input_files_capacity = capacity;
+  }
+  for (size_t i = hash_file_id(dev, ino) & (input_files_capacity - 1);
+       input_files[i].used; i = (i + 1) & (input_files_capacity - 1)) {
+    if (input_files[i].dev == dev && input_files[i].ino == ino)
+      return 1;
+  }
+  insert_input_file(input_files, input_files_capacity, dev, ino);
+  ++num_input_files;
+  return 0;
+}
+
+// out-of-place the file is written to <output_dir>/<out_name>, a file
+// mapped to the output of another file fails. a failed file has NO tasks
+static int plan_output(const char *file_path, const char *out_name,
+                       const char **out_path_out) {
+  *out_path_out = NULL;
+  pthread_mutex_lock(&plan_lock);
+  char *out_path = output_path(out_name);
+  pthread_mutex_unlock(&plan_lock);
+  if (out_path == NULL)
+    return -1;
+  if (make_output_dirs(out_path) != 0) {
+    print_error(out_path, C_ERR_SYS);
+    atomic_fetch_add(&num_tasks_failed, 1);
+    return 0;
+  }
+  pthread_mutex_lock(&plan_lock);
+  const int ret = claim_output_path(out_path);
+  pthread_mutex_unlock(&plan_lock);
+  if (ret < 0)
+    return -1;
+  if (ret == 1) {
+    fprintf(stderr, "Another file is converted to the output file: %s (%s)\n",
+            out_path, file_path);
+    atomic_fetch_add(&num_tasks_failed, 1);
+    return 0;
+  }
+  *out_path_out = out_path;
+  return 0;
+}
+
+// splits a file into tasks, files the size of which the kernels would reject
+// are NOT split, so convert_file reports the error. a converted file has NO
+// tasks (*n_tasks is 0). a file is verified by a single task
+static int plan_file(const char *file_path, const char *out_name,
+                     convert_task_t **tasks_out, size_t *n_tasks) {
+  *tasks_out = NULL;
+  *n_tasks = 0;
+  const char *out_path = NULL;
+  if (output_dir != NULL) {
+    if (plan_output(file_path, out_name, &out_path) != 0)
+      return -1;
+    if (out_path == NULL)
+      return 0;
+  }
+  size_t data_size = 0;
+  size_t n_chunks = 1;
+  struct stat file_stat;
+  const bool file_exists = stat(file_path, &file_stat) == 0;
+  // the marker of the first copy is NOT written yet, so is_converted does
+  // NOT catch the second one
+  if (file_exists && out_path == NULL && !(options & OPTION_VERIFY)) {
+    pthread_mutex_lock(&plan_lock);
+    const int ret = claim_input_file(file_stat.st_dev, file_stat.st_ino);
+    pthread_mutex_unlock(&plan_lock);
+    if (ret < 0)
+      return -1;
+    if (ret == 1) {
+      fprintf(stderr, "The file is given more than once: %s\n", file_path);
+      atomic_fetch_add(&num_tasks_failed, 1);
+      return 0;
+    }
+  }
+  if (file_exists && file_stat.st_size > FILE_HEADER_SIZE) {
+    data_size = file_stat.st_size - FILE_HEADER_SIZE;
+    if (!(options & (OPTION_FORCE | OPTION_VERIFY)) &&
+        is_converted(file_path, out_path))
+      return 0;
+    if (!(options & OPTION_VERIFY) && chunk_size && data_size > chunk_size &&
+        !(data_size % 12))
+      n_chunks = (data_size + chunk_size - 1) / chunk_size;
+  }
+  int ret = -1;
+  convert_task_t *tasks = NULL;
+  convert_job_t *job = NULL;
+  pthread_mutex_lock(&plan_lock);
+  // out-of-place every file is written to the file system of output_dir
+  if (durability == C_DURABILITY_BATCH && !(options & OPTION_VERIFY) &&
+      out_path == NULL && file_exists &&
+      add_sync_target(file_stat.st_dev, file_path) != 0)
+    goto unlock;
+  tasks =
+      (convert_task_t *)arena_alloc(&arena, sizeof(convert_task_t) * n_chunks);
+  if (tasks == NULL)
+    goto unlock;
+  if (n_chunks > 1 && (job = alloc_job(n_chunks, data_size)) == NULL)
+    goto unlock;
+  ret = 0;
+unlock:
+  pthread_mutex_unlock(&plan_lock);
+  if (ret != 0)
+    return ret;
+  for (size_t i = 0; i < n_chunks; ++i) {
+    convert_task_t *task = &tasks[i];
+    task->file_path = file_path;
+    task->out_path = out_path;
+    task->job = job;
+    task->offset = i * chunk_size;
+    task->size = (job != NULL && data_size - task->offset > chunk_size)
+                     ? chunk_size
+                     : data_size - task->offset;
+  }
+  *tasks_out = tasks;
+  *n_tasks = n_chunks;
+  return 0;
+}
+
+// blocks while the queue is full, the span shows the workers falling behind
+static void push_task(convert_task_t *task) {
+  const uint64_t start = trace_begin();
+  task->seq = atomic_fetch_add(&num_tasks_pushed, 1);
+  atomic_store(&readahead_ring[task->seq % QUEUE_CAPACITY], task);
+  atomic_fetch_add_explicit(&num_bytes_pushed, task->size,
+                            memory_order_relaxed);
+  lf_mpmc_queue_push(&queue, task);
+  trace_end("push", NULL, start);
+}
+
+// largest first (LPT), the chunks of a file stay in file order
+static int compare_tasks(const void *a, const void *b) {
+  const convert_task_t *ta = *(const convert_task_t *const *)a;
+  const convert_task_t *tb = *(const convert_task_t *const *)b;
+  if (ta->size != tb->size)
+    return (ta->size > tb->size) ? -1 : 1;
+  return (ta->offset > tb->offset) - (ta->offset < tb->offset);
+}
+
+// the paths of the command line are known upfront, handing out the largest
+// tasks first keeps a big file picked up last from stretching the makespan
+static int push_files_largest_first(char *const *file_paths,
+                                    const size_t n_files) {
+  int ret = 0;
+  size_t n_tasks = 0;
+  size_t capacity = 0;
+  convert_task_t **task_list = NULL;
+  for (size_t i = 0; i < n_files; ++i) {
+    convert_task_t *tasks;
+    size_t n_file_tasks;
+    const uint64_t start = trace_begin();
+    const int plan_ret = plan_file(file_paths[i], base_name(file_paths[i]),
+                                   &tasks, &n_file_tasks);
+    trace_end("plan", file_paths[i], start);
+    if (plan_ret != 0) {
+      ret = -1;
+      goto err;
+    }
+    if (n_tasks + n_file_tasks > capacity) {
+      capacity = (capacity << 1) + n_file_tasks;
+      convert_task_t **new_task_list = (convert_task_t **)realloc(
+          task_list, sizeof(convert_task_t *) * capacity);
+      if (new_task_list == NULL) {
+        ret = -1;
+        goto err;
+      }
+      task_list = new_task_list;
+    }
+    for (size_t j = 0; j < n_file_tasks; ++j)
+      task_list[n_tasks++] = &tasks[j];
+  }
+  qsort(task_list, n_tasks, sizeof(convert_task_t *), compare_tasks);
+  for (size_t i = 0; i < n_tasks; ++i)
+    push_task(task_list[i]);
+err:
+  free(task_list);
+  return ret;
+}
+
+static int push_file(const char *file_path, const char *out_name) {
+  convert_task_t *tasks;
+  size_t n_tasks;
+  const uint64_t start = trace_begin();
+  const int ret = plan_file(file_path, out_name, &tasks, &n_tasks);
+  trace_end("plan", file_path, start);
+  if (ret != 0)
+    return -1;
+  for (size_t i = 0; i < n_tasks; ++i)
+    push_task(&tasks[i]);
+  return 0;
+}
+
+// the subdirectories of a tree are kept below output_dir
+static int push_walked_file(const char *file_path, const char *rel_path,
+                            void *ctx) {
+  (void)ctx;
+  return push_file(file_path, rel_path);
+}
+
+// an unreadable directory does NOT stop the walk, it fails the batch
+static void print_walk_error(const char *dir_path, const int err,
+                             void *ctx) {
+  (void)ctx;
+  fprintf(stderr, "Unable to read directory: %s\n", dir_path);
+  fprintf(stderr, "System error: %s\n", strerror(err));
+  atomic_fetch_add(&num_walk_errors, 1);
+}
 
-#define QUEUE_PUSH(value)                                                      \
-  if (lf_ow_queue_push(&queue, (value)) != 0) {                                \
-    fprintf(stderr, "Fatal error pushing into queue :(\n");                    \
-    return_code = 1;                                                           \
-    goto err;                                                                  \
+// the files are planned and pushed by the walking threads while they
+// enumerate the trees, so the workers start with the first directory read
+static int push_files_from_dirs(walk_t *w) {
+  w->globs = walk_globs;
+  w->n_globs = num_walk_globs;
+  w->exts = walk_exts;
+  w->n_exts = num_walk_exts;
+  w->on_file = push_walked_file;
+  w->on_error = print_walk_error;
+  // the outputs written into a walked tree are NOT inputs
+  struct stat dir_stat;
+  if (output_dir != NULL && stat(output_dir, &dir_stat) == 0) {
+    w->exclude = true;
+    w->exclude_dev = dir_stat.st_dev;
+    w->exclude_ino = dir_stat.st_ino;
   }
+  return walk_run(w, walk_dirs, num_walk_dirs, num_threads);
+}
+
+static int append_arg(const char ***args, size_t *n_args, const char *arg) {
+  const char **new_args =
+      (const char **)realloc(*args, sizeof(const char *) * (*n_args + 1));
+  if (new_args == NULL)
+    return -1;
+  new_args[(*n_args)++] = arg;
+  *args = new_args;
+  return 0;
+}
 
-#define PATH_READY_ALLOC_AND_PUSH_QUEUE(fbuf, i_fbuf)                          \
-  fbuf[i_fbuf++] = 0;                                                          \
-  char *file_path = (char *)malloc(i_fbuf * sizeof(char));                     \
-  if (file_path == NULL) {                                                     \
-    fprintf(stderr, "Fatal calloc error :(\n");                                \
-    return_code = 1;                                                           \
-    goto err;                                                                  \
-  }                                                                            \
-  memcpy(file_path, fbuf, i_fbuf);                                             \
-  QUEUE_PUSH((const char *)file_path);
+// the paths are pushed as soon as they are read, so the workers convert
+// while a slow producer (e.g. find) is still enumerating the files.
+// the paths are built in the arena, so their length is NOT limited
+static int push_files_from_stdin(void) {
+  char rbuf[RBUF_SIZE];
+  ssize_t nbytes;
+  while ((nbytes = read(STDIN_FILENO, rbuf, RBUF_SIZE)) > 0) {
+    ssize_t i_start = 0;
+    for (ssize_t i_rbuf = 0; i_rbuf < nbytes; ++i_rbuf) {
+      if (rbuf[i_rbuf] != DELIMITER)
+        continue;
+      if (arena_str_append(&arena, &rbuf[i_start], i_rbuf - i_start) != 0)
+        return -1;
+      i_start = i_rbuf + 1;
+      if (!arena_str_len(&arena))
+        continue; // empty line
+      const char *file_path = arena_str_finish(&arena);
+      if (file_path == NULL || push_file(file_path, base_name(file_path)) != 0)
+        return -1;
+    }
+    if (arena_str_append(&arena, &rbuf[i_start], nbytes - i_start) != 0)
+      return -1;
+  }
+  if (nbytes < 0)
+    return C_ERR_SYS;
+  if (arena_str_len(&arena)) {
+    const char *file_path = arena_str_finish(&arena);
+    if (file_path == NULL || push_file(file_path, base_name(file_path)) != 0)
+      return -1;
+  }
+  return 0;
+}
 
 int main(int argc, char *const *argv) {
-  if (lf_ow_queue_init(&queue) != 0) {
+  arena_init(&arena);
+  convert_file_set_mmap_window((size_t)WINDOW_SIZE_DEFAULT_MIB << 20);
+  convert_file_set_pread_threshold((size_t)SMALL_FILE_DEFAULT_MIB << 20);
+  if (lf_mpmc_queue_init(&queue, QUEUE_CAPACITY) != 0) {
     fprintf(stderr, "Fatal error initializing queue :(\n");
     return_code = 1;
     goto err;
@@ -120,118 +1013,368 @@ int main(int argc, char *const *argv) {
   while ((opt = getopt_long(argc, argv, shortopts, long_options,
                             &option_index)) != -1) {
     switch (opt) {
+    case 'a':
+      // a hint further ahead than the queue holds would NOT be found
+      readahead = strtoull(optarg, NULL, 10);
+      if (readahead > QUEUE_CAPACITY)
+        readahead = QUEUE_CAPACITY;
+      break;
+    case 'c':
+      chunk_size =
+          (strtoull(optarg, NULL, 10) << 20) / CHUNK_ALIGN * CHUNK_ALIGN;
+      break;
+    case 'd':
+      if (strcmp(optarg, "per-file") == 0) {
+        durability = C_DURABILITY_FILE;
+      } else if (strcmp(optarg, "batch") == 0) {
+        durability = C_DURABILITY_BATCH;
+      } else if (strcmp(optarg, "none") == 0) {
+        durability = C_DURABILITY_NONE;
+      } else {
+        fprintf(stderr, usage, argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      convert_file_set_durability(durability);
+      break;
+    case 'e':
+      if (append_arg(&walk_exts, &num_walk_exts, optarg) != 0) {
+        fprintf(stderr, "Fatal malloc error :(\n");
+        return_code = 1;
+        goto err;
+      }
+      break;
+    case 'f':
+      options |= OPTION_FORCE;
+      break;
+    case 'g':
+      if (append_arg(&walk_globs, &num_walk_globs, optarg) != 0) {
+        fprintf(stderr, "Fatal malloc error :(\n");
+        return_code = 1;
+        goto err;
+      }
+      break;
     case 'h':
       printf(usage, argv[0]);
       break;
+    case 'H':
+      convert_file_set_huge_pages(true);
+      break;
     case 'i':
       options |= OPTION_STDIN;
       break;
+    case 'l':
+      live_stats_path = optarg;
+      break;
+    case 'L':
+      live_stats_interval = strtoul(optarg, NULL, 10);
+      break;
+    case 'm':
+      // the only format so far, the argument leaves room for others
+      if (strcmp(optarg, "json") != 0) {
+        fprintf(stderr, usage, argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      options |= OPTION_METRICS;
+      break;
+    case 'o':
+      output_dir = optarg;
+      break;
+    case 'p':
+      options |= OPTION_PIPE;
+      break;
+    case 'P':
+      options |= OPTION_PROGRESS;
+      break;
+    case 'r':
+      if (append_arg(&walk_dirs, &num_walk_dirs, optarg) != 0) {
+        fprintf(stderr, "Fatal malloc error :(\n");
+        return_code = 1;
+        goto err;
+      }
+      break;
+    case 's':
+      options |= OPTION_STATS;
+      break;
+    case 'S':
+      convert_file_set_pread_threshold(strtoull(optarg, NULL, 10) << 20);
+      break;
     case 't':
       num_threads = atoi(optarg);
       break;
+    case 'T':
+      trace_path = optarg;
+      break;
+    case 'u':
+      options |= OPTION_IO_URING;
+      break;
     case 'v':
       options |= OPTION_VERBOSE;
       printf("* VERBOSE option set\n");
       break;
+    case 'V':
+      options |= OPTION_VERIFY;
+      break;
+    case 'w':
+      convert_file_set_mmap_window(strtoull(optarg, NULL, 10) << 20);
+      break;
     default:
       fprintf(stderr, usage, argv[0]);
       exit(EXIT_FAILURE);
     }
   }
 
-  if (options & OPTION_STDIN) {
-    if (options & OPTION_VERBOSE)
-      printf("* Reading file paths from STDIN\n");
-    char fbuf[FPATH_BUF_SIZE];
-    char rbuf[RPATH_BUF_SIZE];
-    ssize_t i_fbuf = 0;
-    ssize_t nbytes;
-    while ((nbytes = read(STDIN_FILENO, rbuf, RPATH_BUF_SIZE)) > 0) {
-      for (ssize_t i_rbuf = 0; i_rbuf < nbytes && i_fbuf < FPATH_BUF_SIZE;
-           ++i_rbuf) {
-        if (rbuf[i_rbuf] == DELIMITER) {
-          PATH_READY_ALLOC_AND_PUSH_QUEUE(fbuf, i_fbuf);
-          i_fbuf = 0;
-          continue;
-        }
-        fbuf[i_fbuf++] = rbuf[i_rbuf];
-      }
-      if (i_fbuf >= FPATH_BUF_SIZE) {
-        fprintf(stderr, "File path is too large. Max file path size is 255 "
-                        "characters (bytes).\n");
-        return_code = 1;
-        goto err;
-      }
-    }
-    if (nbytes < 0) {
+  // a single raw file streamed from STDIN to STDOUT, so STDOUT carries
+  // nothing else and there is NO path for files or the stats sidecar
+  if (options & OPTION_PIPE) {
+    if ((options & (OPTION_STDIN | OPTION_STATS | OPTION_VERBOSE |
+                    OPTION_FORCE | OPTION_VERIFY | OPTION_METRICS |
+                    OPTION_PROGRESS)) ||
+        output_dir != NULL || optind < argc || num_walk_dirs) {
+      fprintf(stderr, "Error --pipe converts STDIN to STDOUT, it does NOT "
+                      "take files, [-f], [-i], [-m], [-o], [-P], [-r], [-s], "
+                      "[-v] or [-V].\n");
       return_code = 1;
-      goto sys_err;
-    }
-    if (i_fbuf > 0) {
-      PATH_READY_ALLOC_AND_PUSH_QUEUE(fbuf, i_fbuf);
+      goto err;
     }
-  } else if (optind < argc) {
-    for (ssize_t i = optind; i < argc; ++i) {
-      QUEUE_PUSH(argv[i]);
+    const int ret = convert_stream(STDIN_FILENO, STDOUT_FILENO, NULL);
+    if (ret < 0) {
+      print_error("STDIN", ret);
+      return_code = 1;
     }
-  } else {
+    goto err;
+  }
+
+  // the given files are checked, nothing is converted or written
+  if ((options & OPTION_VERIFY) &&
+      ((options & (OPTION_FORCE | OPTION_STATS)) || output_dir != NULL)) {
+    fprintf(stderr, "Error --verify checks the given files, it does NOT "
+                    "take [-f], [-o] or [-s].\n");
+    return_code = 1;
+    goto err;
+  }
+
+  // the JSON lines are the only output on STDOUT
+  if ((options & OPTION_METRICS) && (options & OPTION_VERBOSE)) {
+    fprintf(stderr, "Error --metrics writes JSON lines to STDOUT, it does "
+                    "NOT take [-v].\n");
+    return_code = 1;
+    goto err;
+  }
+
+  if (!(options & OPTION_STDIN) && optind >= argc && !num_walk_dirs) {
     fprintf(stderr, "Error no files to process.\n");
     fprintf(stderr, usage, argv[0]);
     return_code = 1;
     goto err;
   }
+  if (num_threads < 1) {
+    fprintf(stderr, "Error invalid number of threads [-t threads].\n");
+    return_code = 1;
+    goto err;
+  }
+  // created once upfront, so the files do NOT fail one by one and the walk
+  // can exclude it
+  if (output_dir != NULL && make_output_dir() != 0) {
+    fprintf(stderr, "Unable to create the output directory: %s\n",
+            output_dir);
+    PRINT_SYS_ERR;
+    return_code = 1;
+    goto err;
+  }
 
-  if (num_threads > 1) {
-    threads = malloc(sizeof(pthread_t) * num_threads);
-    if (threads == NULL) {
+  // mmap stays the fallback if the kernel does NOT support io_uring
+  if ((options & OPTION_IO_URING) &&
+      convert_file_set_io(C_IO_URING) != C_SUCCESS) {
+    fprintf(stderr, "io_uring is NOT supported, falling back to mmap.\n");
+    PRINT_SYS_ERR;
+  } else if ((options & OPTION_IO_URING) && (options & OPTION_VERBOSE)) {
+    printf("* Using the io_uring backend\n");
+  }
+
+  workers = (worker_t *)calloc(num_threads, sizeof(worker_t));
+  counters = (metrics_counters_t *)aligned_alloc(
+      _Alignof(metrics_counters_t), sizeof(metrics_counters_t) * num_threads);
+  if (workers == NULL || counters == NULL) {
+    fprintf(stderr, "Fatal malloc error :(\n");
+    return_code = 1;
+    goto err;
+  }
+  memset(counters, 0, sizeof(metrics_counters_t) * num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    workers[i].index = i;
+    workers[i].counters = &counters[i];
+    if ((options & OPTION_STATS) && cl_stats_create(&workers[i].stats) < 0) {
+      fprintf(stderr, "Fatal malloc error :(\n");
+      return_code = 1;
+      goto err;
+    }
+  }
+
+  // every thread inherits the mask, so only the live statistics take SIGUSR1
+  sigset_t sigusr1_set;
+  sigemptyset(&sigusr1_set);
+  sigaddset(&sigusr1_set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &sigusr1_set, NULL);
+
+  if (trace_path != NULL) {
+    if (trace_enable(TRACE_SPANS_PER_THREAD) != 0) {
       fprintf(stderr, "Fatal malloc error :(\n");
       return_code = 1;
       goto err;
     }
+    trace_thread("main", 0);
   }
+
+  batch_start_ns = metrics_now_ns();
   if (options & OPTION_VERBOSE)
     printf("* Starting %d worker threads\n", num_threads);
-  for (int i = 1; i < num_threads; ++i) {
-    pthread_t tid;
-    if (pthread_create(&tid, NULL, worker_thread, &queue) != 0) {
+  for (; num_started < num_threads; ++num_started) {
+    if (pthread_create(&workers[num_started].tid, NULL, worker_thread,
+                       &workers[num_started]) != 0) {
       fprintf(stderr, "Fatal error while creating thread. Consider checking "
                       "[-t threads].\n");
       return_code = 1;
-      goto err;
+      break;
+    }
+  }
+  if (num_started == num_threads) {
+    if (pthread_create(&live_stats_tid, NULL, live_stats_thread, NULL) == 0)
+      live_stats_started = true;
+    else
+      fprintf(stderr, "Error creating the live statistics thread.\n");
+    if (options & OPTION_PROGRESS) {
+      if (pthread_create(&progress_tid, NULL, progress_thread, NULL) == 0)
+        progress_started = true;
+      else
+        fprintf(stderr, "Error creating the progress thread.\n");
     }
-    threads[i] = tid;
   }
 
-  worker_thread(&queue);
+  // the files of the command line, the directory trees and STDIN in order
+  if (num_started == num_threads) {
+    int ret = 0;
+    if (optind < argc)
+      ret = push_files_largest_first(&argv[optind], argc - optind);
+    if (ret == 0 && num_walk_dirs) {
+      if (options & OPTION_VERBOSE)
+        printf("* Walking %zu directories with %d threads\n", num_walk_dirs,
+               num_threads);
+      if ((ret = walk_init(&walk)) == 0) {
+        walk_is_init = true;
+        ret = push_files_from_dirs(&walk);
+      }
+    }
+    if (ret == 0 && (options & OPTION_STDIN)) {
+      if (options & OPTION_VERBOSE)
+        printf("* Reading file paths from STDIN\n");
+      ret = push_files_from_stdin();
+    }
+    if (ret == C_ERR_SYS) {
+      fprintf(stderr, "A system error occurend while reading STDIN\n");
+      PRINT_SYS_ERR;
+      return_code = 1;
+    } else if (ret != 0) {
+      fprintf(stderr, "Fatal error planning the conversion tasks :(\n");
+      return_code = 1;
+    }
+  }
+  // the workers finish the tasks pushed so far, even after an error
+  lf_mpmc_queue_close(&queue);
+  atomic_store(&pushing_done, true);
 
   if (options & OPTION_VERBOSE)
-    printf("* Joining %d worker threads\n", num_threads);
-  for (int i = 1; i < num_threads; ++i) {
-    if (pthread_join(threads[i], NULL) != 0) {
+    printf("* Joining %d worker threads\n", num_started);
+  for (int i = 0; i < num_started; ++i) {
+    if (pthread_join(workers[i].tid, NULL) != 0) {
       fprintf(stderr, "Error while joining thread.\n");
       return_code = 2;
       goto err;
     }
   }
+  stop_progress();
+  stop_live_stats();
 
-  if (options & OPTION_VERBOSE)
+  // one syncfs per file system instead of a sync per file
+  if (durability == C_DURABILITY_BATCH && output_dir != NULL &&
+      add_sync_target(0, output_dir) != 0) {
+    fprintf(stderr, "Fatal malloc error :(\n");
+    return_code = 1;
+  }
+  for (size_t i = 0; i < num_sync_targets; ++i) {
+    if (options & OPTION_VERBOSE)
+      printf("* Syncing the file system of: %s\n", sync_targets[i].path);
+    const uint64_t start = trace_begin();
+    const int ret = convert_file_sync_fs(sync_targets[i].path);
+    trace_end("syncfs", sync_targets[i].path, start);
+    if (ret != C_SUCCESS) {
+      fprintf(stderr, "A system error occurend while syncing: %s\n",
+              sync_targets[i].path);
+      PRINT_SYS_ERR;
+      return_code = 1;
+    }
+  }
+
+  if (options & OPTION_METRICS) {
+    const uint64_t wall_ns = metrics_now_ns() - batch_start_ns;
+    metrics_sink_t batch = {0};
+    int ret = 0;
+    for (int i = 0; i < num_started && ret == 0; ++i)
+      ret = metrics_sink_merge(&batch, &workers[i].metrics);
+    if (ret == 0)
+      ret = metrics_print_batch(stdout, &batch, num_started,
+                                atomic_load(&num_tasks_failed), wall_ns);
+    if (ret != 0) {
+      fprintf(stderr, "Error writing the metrics of the batch\n");
+      PRINT_SYS_ERR;
+      return_code = 1;
+    }
+    if (atomic_load(&num_metrics_errors))
+      return_code = 1;
+    metrics_sink_free(&batch);
+  }
+  // every thread recording spans is joined
+  if (trace_path != NULL && trace_write(trace_path) != 0) {
+    fprintf(stderr, "Error writing the trace: %s\n", trace_path);
+    PRINT_SYS_ERR;
+    return_code = 1;
+  }
+  // every failed task was reported, the exit status sums them up
+  if (atomic_load(&num_tasks_failed) || atomic_load(&num_walk_errors))
+    return_code = 1;
+
+  if (options & OPTION_VERBOSE && return_code == 0)
     printf("* Successfully joined %d worker threads. Shutting down. :)\n",
            num_threads);
 
 err:
-  if (threads != NULL) {
-    free(threads);
-    threads = NULL;
-  }
-  if (lf_ow_queue_is_init(&queue)) {
-    if (options & OPTION_STDIN) {
-      lf_ow_queue_free_elements(&queue);
+  stop_progress();
+  stop_live_stats();
+  free(counters);
+  counters = NULL;
+  if (workers != NULL) {
+    for (int i = 0; i < num_threads; ++i) {
+      cl_stats_free(workers[i].stats);
+      metrics_sink_free(&workers[i].metrics);
     }
-    lf_ow_queue_free(&queue);
+    free(workers);
+    workers = NULL;
+  }
+  while (jobs != NULL) {
+    convert_job_t *next = jobs->next;
+    free_job(jobs);
+    jobs = next;
   }
+  free(sync_targets);
+  free(output_paths);
+  free(input_files);
+  trace_free();
+  if (walk_is_init)
+    walk_free(&walk);
+  free(walk_dirs);
+  free(walk_globs);
+  free(walk_exts);
+  arena_free(&arena);
+  if (lf_mpmc_queue_is_init(&queue))
+    lf_mpmc_queue_free(&queue);
   return return_code;
-
-sys_err:
-  PRINT_SYS_ERR;
-  goto err;
 }
@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+uint64_t metrics_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int metrics_sink_add(metrics_sink_t *sink, const metrics_file_t *file) {
+  if (sink->files == sink->__capacity) {
+    const size_t capacity = (sink->__capacity << 1) + 64;
+    uint64_t *latencies = (uint64_t *)realloc(sink->__latencies,
+                                              sizeof(uint64_t) * capacity);
+    if (latencies == NULL)
+      return -1;
+    sink->__latencies = latencies;
+    sink->__capacity = capacity;
+  }
+  sink->__latencies[sink->files++] = file->latency_ns;
+  sink->bytes += file->bytes;
+  for (int i = 0; i < C_PHASES; ++i)
+    sink->phases.phase_ns[i] += file->phases.phase_ns[i];
+  return 0;
+}
+
+int metrics_sink_merge(metrics_sink_t *dst, const metrics_sink_t *src) {
+  for (size_t i = 0; i < src->files; ++i) {
+    const metrics_file_t file = {.latency_ns = src->__latencies[i]};
+    if (metrics_sink_add(dst, &file) != 0)
+      return -1;
+  }
+  dst->bytes += src->bytes;
+  for (int i = 0; i < C_PHASES; ++i)
+    dst->phases.phase_ns[i] += src->phases.phase_ns[i];
+  return 0;
+}
+
+void metrics_sink_free(metrics_sink_t *sink) {
+  free(sink->__latencies);
+  memset(sink, 0, sizeof(metrics_sink_t));
+}
+
+// MB (10^6 bytes) per second, like benchmark.py
+static double mb_per_s(const size_t bytes, const uint64_t ns) {
+  return ns ? (double)bytes / ns * 1e3 : 0.0;
+}
+
+void metrics_print_json_string(FILE *out, const char *str) {
+  putc_unlocked('"', out);
+  for (const unsigned char *c = (const unsigned char *)str; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      putc_unlocked('\\', out);
+      putc_unlocked(*c, out);
+    } else if (*c < 0x20) {
+      fprintf(out, "\\u%04x", *c);
+    } else {
+      putc_unlocked(*c, out);
+    }
+  }
+  putc_unlocked('"', out);
+}
+
+static void print_phases(FILE *out, const c_metrics_t *phases) {
+  for (int i = 0; i < C_PHASES; ++i)
+    fprintf(out, ",\"%s_ns\":%" PRIu64, c_phase_name(i), phases->phase_ns[i]);
+}
+
+void metrics_print_file(FILE *out, const metrics_file_t *file) {
+  flockfile(out);
+  fputs("{\"type\":\"file\",\"path\":", out);
+  metrics_print_json_string(out, file->path);
+  fprintf(out, ",\"bytes\":%zu,\"chunks\":%zu,\"thread\":%d,\"isa\":\"%s\"",
+          file->bytes, file->chunks, file->thread, cl_isa_name(cl_isa()));
+  print_phases(out, &file->phases);
+  fprintf(out, ",\"latency_ns\":%" PRIu64 ",\"mb_per_s\":%.1f}\n",
+          file->latency_ns, mb_per_s(file->bytes, file->latency_ns));
+  funlockfile(out);
+}
+
+static int compare_latencies(const void *a, const void *b) {
+  const uint64_t la = *(const uint64_t *)a;
+  const uint64_t lb = *(const uint64_t *)b;
+  return (la > lb) - (la < lb);
+}
+
+// nearest rank
+static uint64_t percentile(const uint64_t *sorted, const size_t n,
+                           const unsigned int p) {
+  if (!n)
+    return 0;
+  const size_t rank = (n * p + 99) / 100;
+  return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+int metrics_print_batch(FILE *out, metrics_sink_t *batch,
+                        const int n_threads, const size_t n_failed,
+                        const uint64_t wall_ns) {
+  qsort(batch->__latencies, batch->files, sizeof(uint64_t),
+        compare_latencies);
+  flockfile(out);
+  fprintf(out,
+          "{\"type\":\"batch\",\"files\":%zu,\"failed\":%zu,\"bytes\":%zu,"
+          "\"threads\":%d,\"isa\":\"%s\"",
+          batch->files, n_failed, batch->bytes, n_threads,
+          cl_isa_name(cl_isa()));
+  print_phases(out, &batch->phases);
+  fprintf(out, ",\"wall_ns\":%" PRIu64 ",\"mb_per_s\":%.1f", wall_ns,
+          mb_per_s(batch->bytes, wall_ns));
+  const unsigned int percentiles[] = {50, 95, 99};
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(unsigned int); ++i)
+    fprintf(out, ",\"latency_p%u_ns\":%" PRIu64, percentiles[i],
+            percentile(batch->__latencies, batch->files, percentiles[i]));
+  fputs("}\n", out);
+  funlockfile(out);
+  return ferror(out) ? -1 : 0;
+}
+
+// a single writer, so the read-modify-write needs NO lock prefix
+static void counter_add(_Atomic uint64_t *counter, const uint64_t value) {
+  atomic_store_explicit(
+      counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+      memory_order_relaxed);
+}
+
+void metrics_counters_add(metrics_counters_t *counters, const size_t files,
+                          const size_t bytes, const size_t errors,
+                          const c_metrics_t *phases) {
+  counter_add(&counters->files, files);
+  counter_add(&counters->bytes, bytes);
+  counter_add(&counters->errors, errors);
+  if (phases == NULL)
+    return;
+  for (int i = 0; i < C_PHASES; ++i)
+    counter_add(&counters->phase_ns[i], phases->phase_ns[i]);
+}
+
+typedef struct counters_snapshot {
+  uint64_t files;
+  uint64_t bytes;
+  uint64_t errors;
+  c_metrics_t phases;
+} counters_snapshot_t;
+
+static void print_counters(FILE *out, const counters_snapshot_t *snapshot) {
+  fprintf(out,
+          "\"files\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"errors\":%" PRIu64,
+          snapshot->files, snapshot->bytes, snapshot->errors);
+  print_phases(out, &snapshot->phases);
+}
+
+// every counter is read on its own, a snapshot taken during a task may
+// count its bytes but NOT its phases yet
+static void load_counters(const metrics_counters_t *counters,
+                          counters_snapshot_t *snapshot) {
+  snapshot->files = atomic_load_explicit(&counters->files,
+                                         memory_order_relaxed);
+  snapshot->bytes = atomic_load_explicit(&counters->bytes,
+                                         memory_order_relaxed);
+  snapshot->errors = atomic_load_explicit(&counters->errors,
+                                          memory_order_relaxed);
+  for (int i = 0; i < C_PHASES; ++i)
+    snapshot->phases.phase_ns[i] =
+        atomic_load_explicit(&counters->phase_ns[i], memory_order_relaxed);
+}
+
+int metrics_print_snapshot(FILE *out, const metrics_counters_t *counters,
+                           const int n_threads, const uint64_t uptime_ns) {
+  counters_snapshot_t total = {0};
+  flockfile(out);
+  fprintf(out, "{\"type\":\"snapshot\",\"uptime_ns\":%" PRIu64
+               ",\"threads\":[",
+          uptime_ns);
+  for (int i = 0; i < n_threads; ++i) {
+    counters_snapshot_t snapshot;
+    load_counters(&counters[i], &snapshot);
+    fprintf(out, "%s{\"thread\":%d,", i ? "," : "", i);
+    print_counters(out, &snapshot);
+    putc_unlocked('}', out);
+    total.files += snapshot.files;
+    total.bytes += snapshot.bytes;
+    total.errors += snapshot.errors;
+    for (int j = 0; j < C_PHASES; ++j)
+      total.phases.phase_ns[j] += snapshot.phases.phase_ns[j];
+  }
+  fputs("],", out);
+  print_counters(out, &total);
+  fprintf(out, ",\"mb_per_s\":%.1f}\n", mb_per_s(total.bytes, uptime_ns));
+  fflush(out);
+  funlockfile(out);
+  return ferror(out) ? -1 : 0;
+}
+
+#define SNAPSHOT_TMP_SUFFIX ".tmp"
+
+int metrics_write_snapshot(const char *path,
+                           const metrics_counters_t *counters,
+                           const int n_threads, const uint64_t uptime_ns) {
+  int ret = 0;
+  const size_t path_len = strlen(path);
+  char *tmp_path = (char *)malloc(path_len + sizeof(SNAPSHOT_TMP_SUFFIX));
+  if (tmp_path == NULL)
+    return -1;
+  memcpy(tmp_path, path, path_len);
+  memcpy(&tmp_path[path_len], SNAPSHOT_TMP_SUFFIX,
+         sizeof(SNAPSHOT_TMP_SUFFIX));
+  FILE *file = fopen(tmp_path, "w");
+  if (file == NULL) {
+    ret = -1;
+    goto err;
+  }
+  ret = metrics_print_snapshot(file, counters, n_threads, uptime_ns);
+  if (fclose(file) != 0)
+    ret = -1;
+  if (ret == 0 && rename(tmp_path, path) != 0)
+    ret = -1;
+
+err:
+  free(tmp_path);
+  return ret;
+}
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include "convert_file.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * the performance metrics of a converted (or verified) file
+ **/
+typedef struct metrics_file {
+  const char *path;
+  size_t bytes; // of pixel data
+  size_t chunks;
+  // from the start of the first task of the file to the end of the last
+  uint64_t latency_ns;
+  c_metrics_t phases; // summed up over the chunks
+  int thread;         // the worker finishing the file
+} metrics_file_t;
+
+/**
+ * the totals of the files finished by a worker and their latencies,
+ * the sinks of all workers are merged into the sink of the batch
+ * IMPORTANT: NOT thread safe, every worker owns its sink
+ **/
+typedef struct metrics_sink {
+  size_t files;
+  size_t bytes;
+  c_metrics_t phases;
+  uint64_t *__latencies;
+  size_t __capacity;
+} metrics_sink_t;
+
+/**
+ * the live counters of a worker, only written by the worker and read by a
+ * reporter at any time without locks. a cache line of its own keeps the
+ * counters of the workers from sharing one
+ * IMPORTANT: a single writer, allocate the counters aligned to 64 bytes
+ **/
+typedef struct metrics_counters {
+  _Alignas(64) _Atomic uint64_t files;
+  _Atomic uint64_t bytes;
+  _Atomic uint64_t errors;
+  _Atomic uint64_t phase_ns[C_PHASES];
+} metrics_counters_t;
+
+/**
+ * CLOCK_MONOTONIC in ns
+ **/
+uint64_t metrics_now_ns(void);
+
+/**
+ * IMPORTANT: on error -1 is returned (malloc), nothing of the file is added
+ **/
+int metrics_sink_add(metrics_sink_t *sink, const metrics_file_t *file);
+
+/**
+ * adds the files of src to dst
+ * IMPORTANT: on error -1 is returned (malloc)
+ **/
+int metrics_sink_merge(metrics_sink_t *dst, const metrics_sink_t *src);
+void metrics_sink_free(metrics_sink_t *sink);
+
+/**
+ * writes str as a JSON string, e.g. a path, which is NOT under our control
+ **/
+void metrics_print_json_string(FILE *out, const char *str);
+
+/**
+ * writes the metrics of the file as a single JSON line, the lines of
+ * concurrent writers do NOT interleave
+ **/
+void metrics_print_file(FILE *out, const metrics_file_t *file);
+
+/**
+ * writes the totals of the batch and the p50/p95/p99 latency of its files as
+ * a single JSON line, wall_ns is the duration of the batch
+ * IMPORTANT: sorts the latencies of batch
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int metrics_print_batch(FILE *out, metrics_sink_t *batch, int n_threads,
+                        size_t n_failed, uint64_t wall_ns);
+
+/**
+ * adds a finished task to the counters of its worker, phases may be NULL
+ * IMPORTANT: only called by the worker owning the counters
+ **/
+void metrics_counters_add(metrics_counters_t *counters, size_t files,
+                          size_t bytes, size_t errors,
+                          const c_metrics_t *phases);
+
+/**
+ * writes a snapshot of the counters of n_threads workers (totals and per
+ * worker) as a single JSON line, uptime_ns is the time since the start of
+ * the batch
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int metrics_print_snapshot(FILE *out, const metrics_counters_t *counters,
+                           int n_threads, uint64_t uptime_ns);
+
+/**
+ * replaces the file at path with a snapshot, the snapshot is written to
+ * <path>.tmp and renamed, so a reader never sees a partial snapshot
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int metrics_write_snapshot(const char *path,
+                           const metrics_counters_t *counters, int n_threads,
+                           uint64_t uptime_ns);
+
+#endif
@@ -18,69 +18,148 @@
 
 #include "queue.h"
 
-#define BUF_INIT 8
-
-int lf_ow_queue_init(lf_ow_queue_t *q) {
-  const char **buf = (const char **)calloc(BUF_INIT, sizeof(const char **));
+int lf_mpmc_queue_init(lf_mpmc_queue_t *q, size_t capacity) {
+  size_t size = 2;
+  while (size < capacity)
+    size <<= 1;
+  lf_mpmc_queue_cell_t *buf =
+      (lf_mpmc_queue_cell_t *)malloc(sizeof(lf_mpmc_queue_cell_t) * size);
   if (buf == NULL)
     return -1;
-  q->__capacity = BUF_INIT;
-  atomic_store_explicit(&q->__length, 0, memory_order_relaxed);
+  if (pthread_mutex_init(&q->__lock, NULL) != 0) {
+    free(buf);
+    return -1;
+  }
+  if (pthread_cond_init(&q->__cond, NULL) != 0) {
+    pthread_mutex_destroy(&q->__lock);
+    free(buf);
+    return -1;
+  }
+  for (size_t i = 0; i < size; ++i)
+    atomic_init(&buf[i].__sequence, i);
+  q->__mask = size - 1;
+  atomic_init(&q->__enqueue_pos, 0);
+  atomic_init(&q->__dequeue_pos, 0);
+  atomic_init(&q->__waiting, 0);
+  atomic_init(&q->__closed, false);
   q->__buf = buf;
   return 0;
 }
 
-bool lf_ow_queue_is_init(lf_ow_queue_t *q) {
-  return q->__buf != NULL;
+bool lf_mpmc_queue_is_init(lf_mpmc_queue_t *q) { return q->__buf != NULL; }
+
+bool lf_mpmc_queue_try_push(lf_mpmc_queue_t *q, const void *element) {
+  lf_mpmc_queue_cell_t *cell;
+  size_t pos = atomic_load_explicit(&q->__enqueue_pos, memory_order_relaxed);
+  for (;;) {
+    cell = &q->__buf[pos & q->__mask];
+    const size_t seq =
+        atomic_load_explicit(&cell->__sequence, memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->__enqueue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false; // full
+    } else {
+      pos = atomic_load_explicit(&q->__enqueue_pos, memory_order_relaxed);
+    }
+  }
+  cell->__element = element;
+  atomic_store_explicit(&cell->__sequence, pos + 1, memory_order_release);
+  return true;
 }
 
-int lf_ow_queue_push(lf_ow_queue_t *q, const char *str) {
-  const ssize_t length =
-      atomic_load_explicit(&q->__length, memory_order_relaxed);
-  if (length == q->__capacity) {
-    const char **buf =
-        realloc(q->__buf, sizeof(const char **) * (q->__capacity <<= 1));
-    if (buf == NULL) {
-      free(q->__buf);
-      q->__buf = NULL;
-      return -1;
+bool lf_mpmc_queue_try_pop(lf_mpmc_queue_t *q, const void **element) {
+  lf_mpmc_queue_cell_t *cell;
+  size_t pos = atomic_load_explicit(&q->__dequeue_pos, memory_order_relaxed);
+  for (;;) {
+    cell = &q->__buf[pos & q->__mask];
+    const size_t seq =
+        atomic_load_explicit(&cell->__sequence, memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->__dequeue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false; // empty
+    } else {
+      pos = atomic_load_explicit(&q->__dequeue_pos, memory_order_relaxed);
     }
-    memset(&buf[length], 0, sizeof(const char **) * length);
-    q->__buf = buf;
   }
-  q->__buf[length] = str;
-  const ssize_t new_length = length + 1;
-  q->__initial_length = new_length;
-  atomic_store_explicit(&q->__length, new_length, memory_order_relaxed);
-  return 0;
+  *element = cell->__element;
+  atomic_store_explicit(&cell->__sequence, pos + q->__mask + 1,
+                        memory_order_release);
+  return true;
+}
+
+static bool lf_mpmc_queue_is_full(lf_mpmc_queue_t *q) {
+  return atomic_load(&q->__enqueue_pos) - atomic_load(&q->__dequeue_pos) >
+         q->__mask;
 }
 
-const char *lf_ow_queue_pop(lf_ow_queue_t *q) {
-  const ssize_t current_length =
-      atomic_fetch_sub_explicit(&q->__length, 1, memory_order_relaxed);
-  if (current_length <= 0)
-    return NULL;
-  return q->__buf[q->__initial_length - current_length];
+static bool lf_mpmc_queue_is_empty(lf_mpmc_queue_t *q) {
+  return atomic_load(&q->__enqueue_pos) == atomic_load(&q->__dequeue_pos);
 }
 
-void lf_ow_queue_free_elements(lf_ow_queue_t *q) {
-  for (ssize_t i = 0; i < q->__initial_length; ++i) {
-    free((void *)q->__buf[i]);
+// the waiter registers itself before it checks the queue a last time,
+// so a push or pop racing with it either is seen by the check
+// or sees the waiter and wakes it up
+static void lf_mpmc_queue_wait(lf_mpmc_queue_t *q, const bool for_push) {
+  pthread_mutex_lock(&q->__lock);
+  atomic_fetch_add(&q->__waiting, 1);
+  while (for_push ? lf_mpmc_queue_is_full(q)
+                  : (lf_mpmc_queue_is_empty(q) && !atomic_load(&q->__closed)))
+    pthread_cond_wait(&q->__cond, &q->__lock);
+  atomic_fetch_sub(&q->__waiting, 1);
+  pthread_mutex_unlock(&q->__lock);
+}
+
+static void lf_mpmc_queue_wake(lf_mpmc_queue_t *q) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load(&q->__waiting) == 0)
+    return;
+  pthread_mutex_lock(&q->__lock);
+  pthread_cond_broadcast(&q->__cond);
+  pthread_mutex_unlock(&q->__lock);
+}
+
+void lf_mpmc_queue_push(lf_mpmc_queue_t *q, const void *element) {
+  while (!lf_mpmc_queue_try_push(q, element))
+    lf_mpmc_queue_wait(q, true);
+  lf_mpmc_queue_wake(q);
+}
+
+const void *lf_mpmc_queue_pop(lf_mpmc_queue_t *q) {
+  const void *element;
+  for (;;) {
+    // every push happens before the close, so if the queue was closed
+    // before a failing pop, it is drained
+    const bool closed = atomic_load(&q->__closed);
+    if (lf_mpmc_queue_try_pop(q, &element)) {
+      lf_mpmc_queue_wake(q);
+      return element;
+    }
+    if (closed)
+      return NULL;
+    lf_mpmc_queue_wait(q, false);
   }
 }
 
-void lf_ow_queue_free(lf_ow_queue_t *q) {
-  free(q->__buf);
-  q->__buf = NULL;
-  atomic_store_explicit(&q->__length, 0, memory_order_relaxed);
-  q->__capacity = 0;
+void lf_mpmc_queue_close(lf_mpmc_queue_t *q) {
+  atomic_store(&q->__closed, true);
+  pthread_mutex_lock(&q->__lock);
+  pthread_cond_broadcast(&q->__cond);
+  pthread_mutex_unlock(&q->__lock);
 }
 
-float lf_ow_queue_percentage(lf_ow_queue_t *q) {
-  const ssize_t current_length =
-      atomic_load_explicit(&q->__length, memory_order_relaxed);
-  if (current_length <= 0)
-    return 100.0f;
-  const ssize_t elements_popped = q->__initial_length - current_length;
-  return (((float)elements_popped) / ((float)q->__initial_length)) * 100.0f;
+void lf_mpmc_queue_free(lf_mpmc_queue_t *q) {
+  pthread_cond_destroy(&q->__cond);
+  pthread_mutex_destroy(&q->__lock);
+  free(q->__buf);
+  q->__buf = NULL;
 }
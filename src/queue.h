@@ -16,28 +16,62 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
-#ifndef __LOCK_FREE_ONE_WAY_QUEUE_H__
-#define __LOCK_FREE_ONE_WAY_QUEUE_H__
+#ifndef __LOCK_FREE_MPMC_QUEUE_H__
+#define __LOCK_FREE_MPMC_QUEUE_H__
 
+#include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <string.h>
 #include <sys/types.h>
 
-typedef struct lf_ow_queue {
-  ssize_t __initial_length;
-  _Atomic ssize_t __length;
-  ssize_t __capacity;
-  const char **__buf;
-} lf_ow_queue_t;
-
-int lf_ow_queue_init(lf_ow_queue_t *q);
-bool lf_ow_queue_is_init(lf_ow_queue_t *q);
-int lf_ow_queue_push(lf_ow_queue_t *q, const char *str);
-const char *lf_ow_queue_pop(lf_ow_queue_t *q);
-void lf_ow_queue_free_elements(lf_ow_queue_t *q);
-void lf_ow_queue_free(lf_ow_queue_t *q);
-float lf_ow_queue_percentage(lf_ow_queue_t *q);
+typedef struct lf_mpmc_queue_cell {
+  _Atomic size_t __sequence;
+  const void *__element;
+} lf_mpmc_queue_cell_t;
+
+/**
+ * bounded lock-free multi producer multi consumer queue
+ * (Dmitry Vyukov's sequence numbered ring buffer),
+ * the blocking push and pop only fall back to a condition variable
+ * while the queue is full or empty
+ **/
+typedef struct lf_mpmc_queue {
+  lf_mpmc_queue_cell_t *__buf;
+  size_t __mask;
+  _Alignas(64) _Atomic size_t __enqueue_pos;
+  _Alignas(64) _Atomic size_t __dequeue_pos;
+  _Alignas(64) _Atomic int __waiting;
+  _Atomic bool __closed;
+  pthread_mutex_t __lock;
+  pthread_cond_t __cond;
+} lf_mpmc_queue_t;
+
+/**
+ * IMPORTANT: capacity is rounded up to the next power of 2
+ **/
+int lf_mpmc_queue_init(lf_mpmc_queue_t *q, size_t capacity);
+bool lf_mpmc_queue_is_init(lf_mpmc_queue_t *q);
+bool lf_mpmc_queue_try_push(lf_mpmc_queue_t *q, const void *element);
+bool lf_mpmc_queue_try_pop(lf_mpmc_queue_t *q, const void **element);
+
+/**
+ * blocks while the queue is full
+ * IMPORTANT: element must NOT be NULL
+ **/
+void lf_mpmc_queue_push(lf_mpmc_queue_t *q, const void *element);
+
+/**
+ * blocks while the queue is empty,
+ * returns NULL once the queue is closed and drained
+ **/
+const void *lf_mpmc_queue_pop(lf_mpmc_queue_t *q);
+
+/**
+ * IMPORTANT: NO element may be pushed after closing the queue
+ **/
+void lf_mpmc_queue_close(lf_mpmc_queue_t *q);
+void lf_mpmc_queue_free(lf_mpmc_queue_t *q);
 
 #endif
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+#include "metrics.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct trace_event {
+  const char *name;
+  const char *arg;
+  uint64_t start_ns;
+  uint64_t end_ns;
+} trace_event_t;
+
+// only written by its thread, read by trace_write after the join
+typedef struct trace_buf {
+  struct trace_buf *next;
+  const char *name;
+  int index;
+  int tid; // in the order of the first span of the threads
+  size_t n_events; // ever recorded, the last capacity events are kept
+  trace_event_t events[];
+} trace_buf_t;
+
+static bool enabled = false;
+static size_t capacity = 0;
+static uint64_t origin_ns = 0;
+static trace_buf_t *bufs = NULL;
+static int num_bufs = 0;
+static pthread_mutex_t bufs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t buf_key;
+
+int trace_enable(const size_t spans_per_thread) {
+  if (pthread_key_create(&buf_key, NULL) != 0)
+    return -1;
+  capacity = spans_per_thread ? spans_per_thread : 1;
+  origin_ns = metrics_now_ns();
+  enabled = true;
+  return 0;
+}
+
+bool trace_enabled(void) { return enabled; }
+
+// the buffer of a thread is allocated with its first span and lives until
+// trace_free, so the spans of a finished thread are still written
+static trace_buf_t *trace_buf_get(void) {
+  trace_buf_t *buf = (trace_buf_t *)pthread_getspecific(buf_key);
+  if (buf != NULL)
+    return buf;
+  buf = (trace_buf_t *)malloc(sizeof(trace_buf_t) +
+                              sizeof(trace_event_t) * capacity);
+  if (buf == NULL)
+    return NULL;
+  buf->name = "thread";
+  buf->index = 0;
+  buf->n_events = 0;
+  if (pthread_setspecific(buf_key, buf) != 0) {
+    free(buf);
+    return NULL;
+  }
+  pthread_mutex_lock(&bufs_lock);
+  buf->tid = ++num_bufs;
+  buf->next = bufs;
+  bufs = buf;
+  pthread_mutex_unlock(&bufs_lock);
+  return buf;
+}
+
+void trace_thread(const char *name, const int index) {
+  if (!enabled)
+    return;
+  trace_buf_t *buf = trace_buf_get();
+  if (buf == NULL)
+    return;
+  buf->name = name;
+  buf->index = index;
+}
+
+uint64_t trace_begin(void) { return enabled ? metrics_now_ns() : 0; }
+
+void trace_span(const char *name, const char *arg, const uint64_t start_ns,
+                const uint64_t end_ns) {
+  if (!enabled)
+    return;
+  // without a buffer the span is dropped
+  trace_buf_t *buf = trace_buf_get();
+  if (buf == NULL)
+    return;
+  trace_event_t *event = &buf->events[buf->n_events++ % capacity];
+  event->name = name;
+  event->arg = arg;
+  event->start_ns = start_ns;
+  event->end_ns = end_ns;
+}
+
+void trace_end(const char *name, const char *arg, const uint64_t start_ns) {
+  if (enabled)
+    trace_span(name, arg, start_ns, metrics_now_ns());
+}
+
+// the timestamps of the trace-event format are in us
+static double trace_us(const uint64_t ns) { return ns / 1e3; }
+
+int trace_write(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return -1;
+  const int pid = (int)getpid();
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+  bool first = true;
+  for (const trace_buf_t *buf = bufs; buf != NULL; buf = buf->next) {
+    fprintf(file,
+            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+            first ? "" : ",", pid, buf->tid, buf->name, buf->index);
+    first = false;
+    const size_t n_kept =
+        (buf->n_events > capacity) ? capacity : buf->n_events;
+    for (size_t i = buf->n_events - n_kept; i < buf->n_events; ++i) {
+      const trace_event_t *event = &buf->events[i % capacity];
+      fprintf(file,
+              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f",
+              event->name, pid, buf->tid,
+              trace_us(event->start_ns - origin_ns),
+              trace_us(event->end_ns - event->start_ns));
+      if (event->arg != NULL) {
+        fputs(",\"args\":{\"path\":", file);
+        metrics_print_json_string(file, event->arg);
+        fputc('}', file);
+      }
+      fputc('}', file);
+    }
+  }
+  fputs("\n]}\n", file);
+  int ret = ferror(file) ? -1 : 0;
+  if (fclose(file) != 0)
+    ret = -1;
+  return ret;
+}
+
+void trace_free(void) {
+  while (bufs != NULL) {
+    trace_buf_t *next = bufs->next;
+    free(bufs);
+    bufs = next;
+  }
+  if (enabled)
+    pthread_key_delete(buf_key);
+  enabled = false;
+}
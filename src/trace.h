@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * records timestamped spans (CLOCK_MONOTONIC) into a ring buffer per thread
+ * and writes them as trace-event JSON (Chrome tracing, Perfetto).
+ * a span costs a clock read and a store into the buffer of the thread,
+ * without trace_enable a single branch. a full buffer overwrites its oldest
+ * spans, so a long batch keeps its latest spans
+ **/
+
+/**
+ * IMPORTANT: NOT thread safe, enable tracing before starting the threads
+ * IMPORTANT: on error -1 is returned (malloc)
+ **/
+int trace_enable(size_t spans_per_thread);
+bool trace_enabled(void);
+
+/**
+ * names the calling thread in the trace, e.g. "worker" 3
+ **/
+void trace_thread(const char *name, int index);
+
+/**
+ * returns the start of a span, 0 if tracing is disabled
+ **/
+uint64_t trace_begin(void);
+
+/**
+ * records the span [start_ns, now), arg (e.g. a file path) is shown with the
+ * span and may be NULL
+ * IMPORTANT: name and arg must live until trace_write
+ **/
+void trace_end(const char *name, const char *arg, uint64_t start_ns);
+
+/**
+ * records the span [start_ns, end_ns)
+ **/
+void trace_span(const char *name, const char *arg, uint64_t start_ns,
+                uint64_t end_ns);
+
+/**
+ * writes the spans of every thread to path
+ * IMPORTANT: NO span may be recorded concurrently, join the threads first
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int trace_write(const char *path);
+void trace_free(void);
+
+#endif
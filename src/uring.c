@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "uring.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg,
+                                 unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+int uring_init(uring_t *r, const unsigned entries) {
+  memset(r, 0, sizeof(uring_t));
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  r->__fd = sys_io_uring_setup(entries, &p);
+  if (r->__fd < 0)
+    return -1;
+  r->__entries = p.sq_entries;
+
+  r->__sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->__cq_ring_size =
+      p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  // since Linux 5.4 both rings share a single mapping
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (r->__cq_ring_size > r->__sq_ring_size)
+      r->__sq_ring_size = r->__cq_ring_size;
+    r->__cq_ring_size = r->__sq_ring_size;
+  }
+  r->__sq_ring = mmap(NULL, r->__sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->__fd, IORING_OFF_SQ_RING);
+  if (r->__sq_ring == MAP_FAILED)
+    goto err;
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    r->__cq_ring = r->__sq_ring;
+  } else {
+    r->__cq_ring = mmap(NULL, r->__cq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, r->__fd, IORING_OFF_CQ_RING);
+    if (r->__cq_ring == MAP_FAILED)
+      goto err_sq_ring;
+  }
+  r->__sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->__sqes =
+      (struct io_uring_sqe *)mmap(NULL, r->__sqes_size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, r->__fd,
+                                  IORING_OFF_SQES);
+  if (r->__sqes == MAP_FAILED)
+    goto err_cq_ring;
+
+  char *sq = (char *)r->__sq_ring;
+  r->__sq_head = (unsigned *)&sq[p.sq_off.head];
+  r->__sq_tail = (unsigned *)&sq[p.sq_off.tail];
+  r->__sq_mask = (unsigned *)&sq[p.sq_off.ring_mask];
+  r->__sq_array = (unsigned *)&sq[p.sq_off.array];
+  char *cq = (char *)r->__cq_ring;
+  r->__cq_head = (unsigned *)&cq[p.cq_off.head];
+  r->__cq_tail = (unsigned *)&cq[p.cq_off.tail];
+  r->__cq_mask = (unsigned *)&cq[p.cq_off.ring_mask];
+  r->__cqes = (struct io_uring_cqe *)&cq[p.cq_off.cqes];
+  return 0;
+
+err_cq_ring:
+  if (r->__cq_ring != r->__sq_ring)
+    munmap(r->__cq_ring, r->__cq_ring_size);
+err_sq_ring:
+  munmap(r->__sq_ring, r->__sq_ring_size);
+err:;
+  const int err = errno;
+  close(r->__fd);
+  errno = err;
+  return -1;
+}
+
+int uring_register_buffers(uring_t *r, const struct iovec *iovs,
+                           const unsigned n) {
+  return (sys_io_uring_register(r->__fd, IORING_REGISTER_BUFFERS, iovs, n) < 0)
+             ? -1
+             : 0;
+}
+
+struct io_uring_sqe *uring_get_sqe(uring_t *r) {
+  // only the kernel advances the head
+  const unsigned head = __atomic_load_n(r->__sq_head, __ATOMIC_ACQUIRE);
+  const unsigned tail = *r->__sq_tail + r->__to_submit;
+  if (tail - head >= r->__entries)
+    return NULL;
+  const unsigned index = tail & *r->__sq_mask;
+  struct io_uring_sqe *sqe = &r->__sqes[index];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  r->__sq_array[index] = index;
+  ++r->__to_submit;
+  return sqe;
+}
+
+int uring_submit_and_wait(uring_t *r, const unsigned wait_nr) {
+  unsigned to_submit = r->__to_submit;
+  if (to_submit) {
+    // publishes the entries written by uring_get_sqe
+    __atomic_store_n(r->__sq_tail, *r->__sq_tail + to_submit,
+                     __ATOMIC_RELEASE);
+    r->__to_submit = 0;
+  }
+  while (to_submit || wait_nr) {
+    const int ret =
+        sys_io_uring_enter(r->__fd, to_submit, wait_nr,
+                           wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    to_submit -= ((unsigned)ret < to_submit) ? (unsigned)ret : to_submit;
+    if (!to_submit)
+      break;
+  }
+  return 0;
+}
+
+struct io_uring_cqe *uring_peek_cqe(uring_t *r) {
+  const unsigned head = *r->__cq_head;
+  if (head == __atomic_load_n(r->__cq_tail, __ATOMIC_ACQUIRE))
+    return NULL;
+  return &r->__cqes[head & *r->__cq_mask];
+}
+
+void uring_cqe_seen(uring_t *r) {
+  __atomic_store_n(r->__cq_head, *r->__cq_head + 1, __ATOMIC_RELEASE);
+}
+
+void uring_free(uring_t *r) {
+  munmap(r->__sqes, r->__sqes_size);
+  if (r->__cq_ring != r->__sq_ring)
+    munmap(r->__cq_ring, r->__cq_ring_size);
+  munmap(r->__sq_ring, r->__sq_ring_size);
+  close(r->__fd);
+}
+
+#endif
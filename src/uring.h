@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+
+/**
+ * minimal io_uring wrapper on top of the raw system calls,
+ * so the build does NOT depend on liburing
+ * IMPORTANT: NOT thread safe, every thread owns its ring
+ **/
+typedef struct uring {
+  int __fd;
+  unsigned __entries;
+  unsigned __to_submit;
+  unsigned *__sq_head;
+  unsigned *__sq_tail;
+  unsigned *__sq_mask;
+  unsigned *__sq_array;
+  struct io_uring_sqe *__sqes;
+  unsigned *__cq_head;
+  unsigned *__cq_tail;
+  unsigned *__cq_mask;
+  struct io_uring_cqe *__cqes;
+  void *__sq_ring;
+  size_t __sq_ring_size;
+  void *__cq_ring;
+  size_t __cq_ring_size;
+  size_t __sqes_size;
+} uring_t;
+
+/**
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int uring_init(uring_t *r, unsigned entries);
+
+/**
+ * registers buffers for IORING_OP_READ_FIXED and IORING_OP_WRITE_FIXED
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int uring_register_buffers(uring_t *r, const struct iovec *iovs, unsigned n);
+
+/**
+ * returns a zeroed submission queue entry,
+ * NULL if the submission queue is full
+ **/
+struct io_uring_sqe *uring_get_sqe(uring_t *r);
+
+/**
+ * submits the queued entries and waits for wait_nr completions
+ * IMPORTANT: on error -1 is returned, check errno
+ **/
+int uring_submit_and_wait(uring_t *r, unsigned wait_nr);
+
+/**
+ * returns the next completion, NULL if there is none
+ * IMPORTANT: mark the completion with uring_cqe_seen before the next peek
+ **/
+struct io_uring_cqe *uring_peek_cqe(uring_t *r);
+void uring_cqe_seen(uring_t *r);
+
+void uring_free(uring_t *r);
+
+#endif
+
+#endif
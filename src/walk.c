@@ -0,0 +1,306 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "walk.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdint.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+
+// a single getdents64 returns the entries of a directory with ~2000 files
+#define DENTS_BUF_SIZE (64 * 1024)
+
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+#endif
+
+typedef struct walk_dir {
+  const char *path;
+  size_t root_len; // the prefix of the walked directory in path
+} walk_dir_t;
+
+typedef struct walk_thread {
+  walk_t *w;
+  arena_t *arena; // the paths found by the thread
+  pthread_t tid;
+} walk_thread_t;
+
+int walk_init(walk_t *w) {
+  memset(w, 0, sizeof(walk_t));
+  atomic_init(&w->__stopped, false);
+  if (pthread_mutex_init(&w->__lock, NULL) != 0)
+    return -1;
+  if (pthread_cond_init(&w->__cond, NULL) != 0) {
+    pthread_mutex_destroy(&w->__lock);
+    return -1;
+  }
+  return 0;
+}
+
+// the first error stops every thread
+static void walk_stop(walk_t *w, const int ret) {
+  pthread_mutex_lock(&w->__lock);
+  if (!atomic_load(&w->__stopped)) {
+    w->__ret = ret;
+    atomic_store(&w->__stopped, true);
+  }
+  pthread_cond_broadcast(&w->__cond);
+  pthread_mutex_unlock(&w->__lock);
+}
+
+static int walk_push_dir(walk_t *w, const char *dir_path,
+                         const size_t root_len) {
+  int ret = 0;
+  pthread_mutex_lock(&w->__lock);
+  if (w->__n_dirs == w->__dirs_capacity) {
+    const size_t capacity = (w->__dirs_capacity << 1) + 64;
+    walk_dir_t *dirs =
+        (walk_dir_t *)realloc(w->__dirs, sizeof(walk_dir_t) * capacity);
+    if (dirs == NULL) {
+      ret = -1;
+      goto unlock;
+    }
+    w->__dirs = dirs;
+    w->__dirs_capacity = capacity;
+  }
+  w->__dirs[w->__n_dirs].path = dir_path;
+  w->__dirs[w->__n_dirs++].root_len = root_len;
+  ++w->__pending;
+  pthread_cond_signal(&w->__cond);
+unlock:
+  pthread_mutex_unlock(&w->__lock);
+  return ret;
+}
+
+// the length of dir_path including the slash join_path appends
+static size_t dir_prefix_len(const char *dir_path) {
+  const size_t dir_len = strlen(dir_path);
+  return (dir_len && dir_path[dir_len - 1] != '/') ? dir_len + 1 : dir_len;
+}
+
+static const char *join_path(arena_t *arena, const char *dir_path,
+                             const char *name) {
+  const size_t dir_len = strlen(dir_path);
+  if (arena_str_append(arena, dir_path, dir_len) != 0 ||
+      (dir_len && dir_path[dir_len - 1] != '/' &&
+       arena_str_append(arena, "/", 1) != 0) ||
+      arena_str_append(arena, name, strlen(name)) != 0)
+    return NULL;
+  return arena_str_finish(arena);
+}
+
+static bool walk_matches(const walk_t *w, const char *name) {
+  if (!w->n_globs && !w->n_exts)
+    return true;
+  for (size_t i = 0; i < w->n_globs; ++i) {
+    if (fnmatch(w->globs[i], name, 0) == 0)
+      return true;
+  }
+  const char *dot = strrchr(name, '.');
+  if (dot == NULL)
+    return false;
+  for (size_t i = 0; i < w->n_exts; ++i) {
+    const char *ext = w->exts[i];
+    if (*ext == '.')
+      ++ext;
+    if (strcasecmp(dot + 1, ext) == 0)
+      return true;
+  }
+  return false;
+}
+
+static bool walk_excludes(const walk_t *w, const struct stat *dir_stat) {
+  return w->exclude && dir_stat->st_dev == w->exclude_dev &&
+         dir_stat->st_ino == w->exclude_ino;
+}
+
+static int walk_entry(walk_t *w, arena_t *arena, const int dir_fd,
+                      const walk_dir_t *dir, const char *name,
+                      unsigned char type) {
+  if (name[0] == '.' &&
+      (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+    return 0;
+  // some file systems do NOT report the type, the entry may be gone.
+  // the excluded directory is recognized by its device and inode
+  struct stat entry_stat;
+  if (type == DT_UNKNOWN || (type == DT_DIR && w->exclude)) {
+    if (fstatat(dir_fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0)
+      return 0;
+    if (S_ISDIR(entry_stat.st_mode))
+      type = DT_DIR;
+    else if (S_ISREG(entry_stat.st_mode))
+      type = DT_REG;
+    else
+      type = DT_UNKNOWN;
+  }
+  if (type == DT_DIR) {
+    if (walk_excludes(w, &entry_stat))
+      return 0;
+    const char *path = join_path(arena, dir->path, name);
+    return (path != NULL) ? walk_push_dir(w, path, dir->root_len) : -1;
+  }
+  if (type != DT_REG || !walk_matches(w, name))
+    return 0;
+  const char *path = join_path(arena, dir->path, name);
+  return (path != NULL) ? w->on_file(path, &path[dir->root_len], w->ctx)
+                        : -1;
+}
+
+static int walk_dir(walk_t *w, arena_t *arena, char *dents,
+                    const walk_dir_t *dir) {
+  const char *dir_path = dir->path;
+  const int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd < 0) {
+    if (w->on_error != NULL)
+      w->on_error(dir_path, errno, w->ctx);
+    return 0;
+  }
+  int ret = 0;
+#ifdef __linux__
+  long nbytes = 0;
+  while (ret == 0 && !atomic_load(&w->__stopped) &&
+         (nbytes = syscall(SYS_getdents64, dir_fd, dents, DENTS_BUF_SIZE)) >
+             0) {
+    for (long pos = 0; ret == 0 && pos < nbytes;) {
+      const struct linux_dirent64 *dent =
+          (const struct linux_dirent64 *)&dents[pos];
+      pos += dent->d_reclen;
+      ret = walk_entry(w, arena, dir_fd, dir, dent->d_name, dent->d_type);
+    }
+  }
+  if (ret == 0 && nbytes < 0 && w->on_error != NULL)
+    w->on_error(dir_path, errno, w->ctx);
+  close(dir_fd);
+#else
+  (void)dents;
+  // closedir closes dir_fd
+  DIR *dir = fdopendir(dir_fd);
+  if (dir == NULL) {
+    if (w->on_error != NULL)
+      w->on_error(dir_path, errno, w->ctx);
+    close(dir_fd);
+    return 0;
+  }
+  struct dirent *dent;
+  while (ret == 0 && !atomic_load(&w->__stopped) &&
+         (dent = readdir(dir)) != NULL)
+    ret = walk_entry(w, arena, dir_fd, dir, dent->d_name, dent->d_type);
+  closedir(dir);
+#endif
+  return ret;
+}
+
+// takes the directories until every queued directory is read, a thread
+// waiting for work is woken by a new directory or the end of the walk
+static void *walk_thread(void *ctx) {
+  walk_thread_t *thread = (walk_thread_t *)ctx;
+  walk_t *w = thread->w;
+  char *dents = NULL;
+#ifdef __linux__
+  if ((dents = (char *)malloc(DENTS_BUF_SIZE)) == NULL) {
+    walk_stop(w, -1);
+    return NULL;
+  }
+#endif
+  for (;;) {
+    pthread_mutex_lock(&w->__lock);
+    while (!w->__n_dirs && w->__pending && !atomic_load(&w->__stopped))
+      pthread_cond_wait(&w->__cond, &w->__lock);
+    if (!w->__n_dirs || atomic_load(&w->__stopped)) {
+      pthread_mutex_unlock(&w->__lock);
+      break;
+    }
+    const walk_dir_t dir = w->__dirs[--w->__n_dirs];
+    pthread_mutex_unlock(&w->__lock);
+    const int ret = walk_dir(w, thread->arena, dents, &dir);
+    if (ret != 0)
+      walk_stop(w, ret);
+    pthread_mutex_lock(&w->__lock);
+    if (--w->__pending == 0)
+      pthread_cond_broadcast(&w->__cond);
+    pthread_mutex_unlock(&w->__lock);
+  }
+  free(dents);
+  return NULL;
+}
+
+int walk_run(walk_t *w, const char *const *dirs, const size_t n_dirs,
+             int n_threads) {
+  if (n_threads < 1)
+    n_threads = 1;
+  w->__arenas = (arena_t *)calloc(n_threads, sizeof(arena_t));
+  walk_thread_t *threads =
+      (walk_thread_t *)calloc(n_threads, sizeof(walk_thread_t));
+  if (w->__arenas == NULL || threads == NULL) {
+    free(threads);
+    return -1;
+  }
+  w->__n_threads = n_threads;
+  for (int i = 0; i < n_threads; ++i) {
+    arena_init(&w->__arenas[i]);
+    threads[i].w = w;
+    threads[i].arena = &w->__arenas[i];
+  }
+  for (size_t i = 0; i < n_dirs; ++i) {
+    struct stat dir_stat;
+    if (w->exclude && stat(dirs[i], &dir_stat) == 0 &&
+        walk_excludes(w, &dir_stat))
+      continue;
+    if (walk_push_dir(w, dirs[i], dir_prefix_len(dirs[i])) != 0) {
+      free(threads);
+      return -1;
+    }
+  }
+  int n_started = 1;
+  for (; n_started < n_threads; ++n_started) {
+    if (pthread_create(&threads[n_started].tid, NULL, walk_thread,
+                       &threads[n_started]) != 0) {
+      walk_stop(w, -1);
+      break;
+    }
+  }
+  walk_thread(&threads[0]);
+  for (int i = 1; i < n_started; ++i)
+    pthread_join(threads[i].tid, NULL);
+  free(threads);
+  return w->__ret;
+}
+
+void walk_free(walk_t *w) {
+  if (w->__arenas != NULL) {
+    for (int i = 0; i < w->__n_threads; ++i)
+      arena_free(&w->__arenas[i]);
+    free(w->__arenas);
+  }
+  free(w->__dirs);
+  pthread_cond_destroy(&w->__cond);
+  pthread_mutex_destroy(&w->__lock);
+  memset(w, 0, sizeof(walk_t));
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2021 Lucas Crämer (GitHub: lc0305)
+ * All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __WALK_H__
+#define __WALK_H__
+
+#include "arena.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * parallel enumeration of the regular files below a set of directories,
+ * every thread reads whole directories (getdents64 on linux) and hands the
+ * subdirectories to the other threads, so a wide tree is read in parallel
+ * and the first files are reported while the rest is still enumerated
+ * IMPORTANT: symbolic links are NOT followed
+ **/
+struct walk_dir;
+
+typedef struct walk {
+  // a file is reported if its name matches one of the globs (fnmatch) or
+  // its extension (after the last dot) is one of exts (case insensitive,
+  // with or without the dot), without filters every regular file is reported
+  const char *const *globs;
+  size_t n_globs;
+  const char *const *exts;
+  size_t n_exts;
+  // called concurrently by the walking threads, the path lives until
+  // walk_free. rel_path points into path, it is the part below the walked
+  // directory. a return value other than 0 stops the walk
+  int (*on_file)(const char *path, const char *rel_path, void *ctx);
+  // called concurrently for a directory that could NOT be read (err is the
+  // errno), the walk continues with the other directories
+  void (*on_error)(const char *path, int err, void *ctx);
+  void *ctx;
+  // the directory with this device and inode is NOT walked (e.g. the
+  // output directory inside a walked tree)
+  bool exclude;
+  dev_t exclude_dev;
+  ino_t exclude_ino;
+  arena_t *__arenas; // one per thread, the paths are NOT copied
+  int __n_threads;
+  struct walk_dir *__dirs; // directories NOT read yet
+  size_t __n_dirs;
+  size_t __dirs_capacity;
+  size_t __pending; // queued or being read
+  _Atomic bool __stopped;
+  int __ret;
+  pthread_mutex_t __lock;
+  pthread_cond_t __cond;
+} walk_t;
+
+/**
+ * IMPORTANT: set the filters and callbacks after walk_init
+ **/
+int walk_init(walk_t *w);
+
+/**
+ * walks the trees below dirs with n_threads threads, the calling thread is
+ * one of them and the call returns once every directory is read.
+ * returns the first return value of on_file other than 0,
+ * -1 on a fatal (malloc, thread) error
+ * IMPORTANT: only a single walk_run per walk_init
+ **/
+int walk_run(walk_t *w, const char *const *dirs, size_t n_dirs,
+             int n_threads);
+
+/**
+ * releases every reported path
+ **/
+void walk_free(walk_t *w);
+
+#endif